@@ -0,0 +1,472 @@
+// headless benchmark of the guard pathfinding, no window and no OpenGL
+//
+// usage: pathfinding_bench [--queries N] [--seed S] [--time-limit SECONDS] [--out FILE] [--data DIR]
+//
+// DIR is the folder with level1..6.txt, data/levels of the project by default.
+// every map gets the same random start/goal queries for every algorithm, the results are
+// written as JSON (to stdout, or FILE) so two runs can be compared by a script.
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+// internal
+#include "nav_grid.hpp"
+#include "path_search.hpp"
+#include "jump_point_search.hpp"
+#include "flow_field.hpp"
+#include "hpa_star.hpp"
+#include "path_smoothing.hpp"
+#include "../ext/project_path.hpp"
+
+using namespace std;
+using glm::ivec2;
+using json = nlohmann::json;
+
+// the clearance the guards search with
+const int BENCH_CLEARANCE = 3;
+const int BENCH_CLUSTER_SIZE = 16;
+
+// generated mazes: corridors wide enough for the guards, one wall tile between them
+const int MAZE_CORRIDOR = 5;
+const int MAZE_SIZES[] = { 64, 128, 256, 512, 1000 };
+
+// a fraction of the maze walls is removed so there is more than one way
+const float MAZE_LOOP_RATE = 0.1f;
+
+struct Query
+{
+	ivec2 start;
+	ivec2 goal;
+};
+
+struct Samples
+{
+	vector<double> us;
+	vector<int> expanded;
+	int found = 0;
+};
+
+// the same format as GameState::LoadLevel()
+static bool LoadLevel(const string &path, NavGrid::LevelMap &levelMap)
+{
+	ifstream in(path);
+	if (!in.is_open())
+		return false;
+
+	string row;
+	levelMap.clear();
+	while (getline(in, row))
+	{
+		if (!row.empty() && row.back() == '\r')
+			row.pop_back();
+		levelMap.push_back(vector<char>(row.begin(), row.end()));
+	}
+	return true;
+}
+
+// a perfect maze (depth first, iterative) of cells with MAZE_CORRIDOR wide corridors, then some
+// walls between two cells are removed to make loops. the tiles left after the last cell are walls
+static NavGrid::LevelMap GenerateMaze(int size, mt19937 &rng)
+{
+	const int pitch = MAZE_CORRIDOR + 1;
+	int cells = (size - 1) / pitch;
+	NavGrid::LevelMap levelMap(size, vector<char>(size, 'W'));
+
+	auto Open = [&](int x0, int y0, int w, int h)
+	{
+		for (int y = y0; y < y0 + h; ++y)
+			for (int x = x0; x < x0 + w; ++x)
+				levelMap[y][x] = ' ';
+	};
+	// the wall between a cell and its neighbour in direction d (0..3 of NAV_NEIGHBOURS)
+	auto OpenWall = [&](int cx, int cy, int d)
+	{
+		ivec2 dir = NAV_NEIGHBOURS[d];
+		int x = cx * pitch + 1, y = cy * pitch + 1;
+		if (dir.x != 0)
+			Open(dir.x > 0 ? x + MAZE_CORRIDOR : x - 1, y, 1, MAZE_CORRIDOR);
+		else
+			Open(x, dir.y > 0 ? y + MAZE_CORRIDOR : y - 1, MAZE_CORRIDOR, 1);
+	};
+
+	for (int cy = 0; cy < cells; ++cy)
+		for (int cx = 0; cx < cells; ++cx)
+			Open(cx * pitch + 1, cy * pitch + 1, MAZE_CORRIDOR, MAZE_CORRIDOR);
+
+	vector<char> visited(cells * cells, 0);
+	vector<ivec2> stack = { ivec2(0, 0) };
+	visited[0] = 1;
+	while (!stack.empty())
+	{
+		ivec2 cell = stack.back();
+		int options[4], count = 0;
+		for (int d = 0; d < 4; ++d)
+		{
+			ivec2 next = cell + NAV_NEIGHBOURS[d];
+			if (next.x >= 0 && next.x < cells && next.y >= 0 && next.y < cells && !visited[next.y * cells + next.x])
+				options[count++] = d;
+		}
+		if (count == 0)
+		{
+			stack.pop_back();
+			continue;
+		}
+		int d = options[uniform_int_distribution<int>(0, count - 1)(rng)];
+		ivec2 next = cell + NAV_NEIGHBOURS[d];
+		OpenWall(cell.x, cell.y, d);
+		visited[next.y * cells + next.x] = 1;
+		stack.push_back(next);
+	}
+
+	uniform_real_distribution<float> chance(0.0f, 1.0f);
+	for (int cy = 0; cy < cells; ++cy)
+	{
+		for (int cx = 0; cx < cells; ++cx)
+		{
+			if (cx + 1 < cells && chance(rng) < MAZE_LOOP_RATE)
+				OpenWall(cx, cy, 0);
+			if (cy + 1 < cells && chance(rng) < MAZE_LOOP_RATE)
+				OpenWall(cx, cy, 2);
+		}
+	}
+	return levelMap;
+}
+
+// the flat baseline: breadth first over the 8 neighbours, every step costs the same, so the path
+// has the fewest steps but not the shortest length
+class BreadthFirstSearch
+{
+public:
+	void Init(const NavGrid &grid)
+	{
+		this->grid = &grid;
+		stamp.assign(grid.GetSize(), 0);
+		generation = 0;
+		queue.resize(grid.GetSize());
+		expandedCount = 0;
+	}
+
+	bool Find(ivec2 start, ivec2 goal, int clearance)
+	{
+		if (++generation == 0)
+		{
+			fill(stamp.begin(), stamp.end(), 0);
+			generation = 1;
+		}
+		expandedCount = 0;
+
+		int head = 0, tail = 0;
+		queue[tail++] = grid->ToIndex(start);
+		stamp[queue[0]] = generation;
+		const int goalIndex = grid->ToIndex(goal);
+		while (head < tail)
+		{
+			int cur = queue[head++];
+			expandedCount++;
+			if (cur == goalIndex)
+				return true;
+
+			ivec2 curPos = grid->ToPos(cur);
+			bool passable[8];
+			for (int d = 0; d < 8; ++d)
+			{
+				ivec2 newPos = curPos + NAV_NEIGHBOURS[d];
+				passable[d] = grid->IsValid(newPos) && grid->GetClearance(grid->ToIndex(newPos)) >= clearance;
+				if (d >= 4)
+					passable[d] = passable[d] && passable[NAV_DIAGONAL_SIDES[d][0]] && passable[NAV_DIAGONAL_SIDES[d][1]];
+				if (!passable[d])
+					continue;
+
+				int next = grid->ToIndex(newPos);
+				if (stamp[next] == generation)
+					continue;
+				stamp[next] = generation;
+				queue[tail++] = next;
+			}
+		}
+		return false;
+	}
+
+	int GetExpandedCount() const { return expandedCount; }
+
+private:
+	const NavGrid *grid = nullptr;
+	vector<uint32_t> stamp;
+	uint32_t generation = 0;
+	vector<int> queue;
+	int expandedCount = 0;
+};
+
+// the length of a path of neighbouring tiles
+static float PathLength(const vector<ivec2> &path)
+{
+	float length = 0;
+	for (size_t i = 1; i < path.size(); ++i)
+	{
+		ivec2 d = glm::abs(path[i] - path[i - 1]);
+		length += d.x != 0 && d.y != 0 ? NAV_STEP_COST[4] : NAV_STEP_COST[0];
+	}
+	return length;
+}
+
+// random pairs of tiles a guard can stand on
+static vector<Query> MakeQueries(const NavGrid &grid, int count, mt19937 &rng)
+{
+	vector<ivec2> tiles;
+	for (int i = 0; i < grid.GetSize(); ++i)
+	{
+		if (grid.GetClearance(i) >= BENCH_CLEARANCE)
+			tiles.push_back(grid.ToPos(i));
+	}
+
+	vector<Query> queries;
+	if (tiles.empty())
+		return queries;
+
+	uniform_int_distribution<size_t> pick(0, tiles.size() - 1);
+	for (int i = 0; i < count; ++i)
+		queries.push_back({ tiles[pick(rng)], tiles[pick(rng)] });
+	return queries;
+}
+
+// run one query at a time until all of them are done or the time limit is reached. the query
+// returns the number of expanded nodes n, or -(n + 1) if it found no complete path
+template <typename F>
+static Samples Run(const vector<Query> &queries, double timeLimit, F query)
+{
+	Samples samples;
+	auto begin = chrono::steady_clock::now();
+	for (const Query &q : queries)
+	{
+		auto start = chrono::steady_clock::now();
+		int expanded = query(q);
+		auto end = chrono::steady_clock::now();
+
+		samples.us.push_back(chrono::duration<double, micro>(end - start).count());
+		samples.expanded.push_back(expanded < 0 ? -expanded - 1 : expanded);
+		if (expanded >= 0)
+			samples.found++;
+
+		if (chrono::duration<double>(end - begin).count() > timeLimit)
+			break;
+	}
+	return samples;
+}
+
+template <typename T>
+static T Percentile(vector<T> values, double p)
+{
+	if (values.empty())
+		return T();
+	size_t index = (size_t)ceil(p * values.size());
+	index = index == 0 ? 0 : index - 1;
+	nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+static json Report(const Samples &samples)
+{
+	double sumUs = 0, sumExpanded = 0;
+	for (double us : samples.us)
+		sumUs += us;
+	for (int e : samples.expanded)
+		sumExpanded += e;
+	size_t n = glm::max<size_t>(samples.us.size(), 1);
+
+	json j;
+	j["queries"] = samples.us.size();
+	j["found"] = samples.found;
+	j["mean_us"] = sumUs / n;
+	j["p99_us"] = Percentile(samples.us, 0.99);
+	j["max_us"] = samples.us.empty() ? 0.0 : *max_element(samples.us.begin(), samples.us.end());
+	j["mean_expanded"] = sumExpanded / n;
+	j["p99_expanded"] = Percentile(samples.expanded, 0.99);
+	return j;
+}
+
+static json BenchMap(const string &name, const NavGrid::LevelMap &levelMap, int queryCount, double timeLimit, mt19937 &rng)
+{
+	NavGrid grid;
+	grid.Build(levelMap);
+	vector<Query> queries = MakeQueries(grid, queryCount, rng);
+
+	json map;
+	map["name"] = name;
+	map["cols"] = grid.GetCols();
+	map["rows"] = grid.GetRows();
+
+	int walkable = 0;
+	for (int i = 0; i < grid.GetSize(); ++i)
+		walkable += grid.IsWalkable(i) ? 1 : 0;
+	map["walkable_tiles"] = walkable;
+
+	json &algorithms = map["algorithms"];
+
+	vector<ivec2> path;
+
+	BreadthFirstSearch bfs;
+	bfs.Init(grid);
+	algorithms["bfs"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			bool found = bfs.Find(q.start, q.goal, BENCH_CLEARANCE);
+			return found ? bfs.GetExpandedCount() : -bfs.GetExpandedCount() - 1;
+		}));
+
+	// the shortest lengths, < 0 if not found or not run in the time limit
+	vector<float> shortest(queries.size(), -1.0f);
+
+	PathSearch astar;
+	astar.Init(grid);
+	algorithms["astar"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			bool found = astar.FindPath(q.start, q.goal, BENCH_CLEARANCE, path);
+			if (found)
+				shortest[&q - queries.data()] = PathLength(path);
+			return found ? astar.GetExpandedCount() : -astar.GetExpandedCount() - 1;
+		}));
+
+	JumpPointSearch jps;
+	jps.Init(grid, BENCH_CLEARANCE);
+	algorithms["jps"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			bool found = jps.FindPath(q.start, q.goal, path);
+			return found ? jps.GetExpandedCount() : -jps.GetExpandedCount() - 1;
+		}));
+
+	// what the path worker does for a guard: the search and the smoothing
+	algorithms["jps_smoothed"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			bool found = jps.FindPath(q.start, q.goal, path);
+			path_string_pull(grid, path, BENCH_CLEARANCE, q.start, q.goal);
+			return found ? jps.GetExpandedCount() : -jps.GetExpandedCount() - 1;
+		}));
+
+	// one build per goal, the whole grid
+	FlowField field;
+	field.Init(grid);
+	algorithms["flow_field"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			field.Build(q.goal, BENCH_CLEARANCE);
+			float cost = field.GetCost(q.start);
+			return cost >= 0 ? field.GetExpandedCount() : -field.GetExpandedCount() - 1;
+		}));
+
+	HPAStar hierarchy;
+	auto buildStart = chrono::steady_clock::now();
+	hierarchy.Build(grid, BENCH_CLUSTER_SIZE, BENCH_CLEARANCE);
+	json &hpa = algorithms["hpa"];
+	// how much longer the paths are than the shortest ones, HPA* goes through the entrances
+	double sumRatio = 0, maxRatio = 0;
+	int ratioCount = 0;
+	hpa = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			bool found = hierarchy.FindPath(q.start, q.goal, path);
+			float length = shortest[&q - queries.data()];
+			if (found && length > 0)
+			{
+				double ratio = PathLength(path) / length;
+				sumRatio += ratio;
+				maxRatio = glm::max(maxRatio, ratio);
+				ratioCount++;
+			}
+			return found ? hierarchy.GetExpandedCount() : -hierarchy.GetExpandedCount() - 1;
+		}));
+	hpa["mean_length_ratio"] = ratioCount > 0 ? sumRatio / ratioCount : 1.0;
+	hpa["max_length_ratio"] = maxRatio;
+	hpa["build_ms"] = chrono::duration<double, milli>(chrono::steady_clock::now() - buildStart).count();
+	hpa["nodes"] = hierarchy.GetNodeCount();
+	hpa["edges"] = hierarchy.GetEdgeCount();
+
+	// what the game does on big levels: the abstract path and the segment the guard walks first
+	vector<ivec2> abstractPath;
+	algorithms["hpa_first_segment"] = Report(Run(queries, timeLimit, [&](const Query &q)
+		{
+			path.clear();
+			bool found = hierarchy.FindAbstractPath(q.start, q.goal, abstractPath) && abstractPath.size() >= 2 &&
+				hierarchy.RefineSegment(abstractPath[0], abstractPath[1], path);
+			return found ? hierarchy.GetExpandedCount() : -hierarchy.GetExpandedCount() - 1;
+		}));
+
+	return map;
+}
+
+int main(int argc, char *argv[])
+{
+	int queryCount = 2000;
+	unsigned int seed = 1;
+	double timeLimit = 5.0; // seconds per algorithm and map
+	string outPath;
+	string levelDir = string(PROJECT_SOURCE_DIR) + "data/levels/";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--queries") == 0 && hasValue)
+			queryCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && hasValue)
+			seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--time-limit") == 0 && hasValue)
+			timeLimit = atof(argv[++i]);
+		else if (strcmp(argv[i], "--out") == 0 && hasValue)
+			outPath = argv[++i];
+		else if (strcmp(argv[i], "--data") == 0 && hasValue)
+			levelDir = string(argv[++i]) + "/";
+		else
+		{
+			cerr << "usage: " << argv[0] << " [--queries N] [--seed S] [--time-limit SECONDS] [--out FILE] [--data DIR]" << endl;
+			return 1;
+		}
+	}
+
+	mt19937 rng(seed);
+
+	json result;
+	result["queries"] = queryCount;
+	result["seed"] = seed;
+	result["time_limit_s"] = timeLimit;
+	result["clearance"] = BENCH_CLEARANCE;
+	json &maps = result["maps"];
+
+	for (int level = 1; level <= 6; ++level)
+	{
+		string name = "level" + to_string(level);
+		NavGrid::LevelMap levelMap;
+		if (!LoadLevel(levelDir + name + ".txt", levelMap))
+		{
+			cerr << "can't open " << levelDir << name << ".txt" << endl;
+			return 1;
+		}
+		cerr << name << endl;
+		maps.push_back(BenchMap(name, levelMap, queryCount, timeLimit, rng));
+	}
+
+	for (int size : MAZE_SIZES)
+	{
+		string name = "maze" + to_string(size);
+		cerr << name << endl;
+		maps.push_back(BenchMap(name, GenerateMaze(size, rng), queryCount, timeLimit, rng));
+	}
+
+	if (outPath.empty())
+	{
+		cout << result.dump(2) << endl;
+	}
+	else
+	{
+		ofstream out(outPath);
+		out << result.dump(2) << endl;
+	}
+	return 0;
+}
@@ -8,7 +8,17 @@ out vec3 vcolor;
 
 // Application data
 uniform mat3 transform;
-uniform mat3 projection;
+
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
 
 void main()
 {
@@ -0,0 +1,72 @@
+#version 330
+
+// Input attributes
+in vec3 in_position;
+in vec2 in_texcoord;
+
+// per instance, the particle (Particle in components.hpp)
+in vec4 in_motion; // origin, velocity
+in vec4 in_wave; // amplitude, frequency, seed
+in vec4 in_shape; // size, angle, spin
+in vec4 in_life; // birth, life, shrink, loop
+
+// Passed to fragment shader
+out vec2 texcoord;
+out vec2 fragPos;
+
+// Application data
+uniform float time;
+uniform vec4 uv_rect; // the corners (u0, v0) and (u1, v1) of the texture in its atlas
+
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
+
+// [0, 1) from a number
+float hash(float x)
+{
+	return fract(sin(x * 12.9898) * 43758.5453);
+}
+
+void main()
+{
+	texcoord = mix(uv_rect.xy, uv_rect.zw, in_texcoord);
+
+	float life = in_life.y;
+	float age = time - in_life.x;
+	vec2 wave = in_wave.xy;
+	float frequency = in_wave.z;
+
+	// a looping particle draws its wave again every time: the amplitude from 0.1 to 1 of the
+	// largest one, the period from 0.01 to 1 of the longest one
+	if (in_life.w > 0.5)
+	{
+		float cycle = floor(age / life);
+		age -= cycle * life;
+		float seed = in_wave.w + cycle;
+		wave *= mix(0.1, 1.0, hash(seed));
+		frequency /= mix(0.01, 1.0, hash(seed + 0.5));
+	}
+
+	// nothing to draw before its birth and after its death
+	float alive = step(0.0, age) * step(age, life);
+	vec2 scale = in_shape.xy * (1.0 - in_life.z * age / life) * alive;
+	vec2 center = in_motion.xy + in_motion.zw * age + wave * sin(frequency * age);
+	float angle = in_shape.z + in_shape.w * age;
+
+	// the same order as Transform: rotate, then scale, then translate
+	float c = cos(angle);
+	float s = sin(angle);
+	vec2 rotated = vec2(c * in_position.x - s * in_position.y, s * in_position.x + c * in_position.y);
+	fragPos = center + scale * rotated;
+
+	vec3 pos = projection * view * vec3(fragPos, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 330
+
+// Input attributes
+in vec3 in_position;
+in vec2 in_texcoord;
+
+// per instance, the sprite
+in vec2 in_offset;
+in vec2 in_scale;
+in float in_angle;
+in vec4 in_uv_rect; // the corners (u0, v0) and (u1, v1) of the sprite in its texture
+in vec3 in_color;
+
+// Passed to fragment shader
+out vec2 texcoord;
+out vec2 fragPos;
+out vec3 spriteColor;
+
+// Application data
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
+
+void main()
+{
+	texcoord = mix(in_uv_rect.xy, in_uv_rect.zw, in_texcoord);
+	spriteColor = in_color;
+
+	// the same order as Transform: rotate, then scale, then translate
+	float c = cos(in_angle);
+	float s = sin(in_angle);
+	vec2 rotated = vec2(c * in_position.x - s * in_position.y, s * in_position.x + c * in_position.y);
+	fragPos = in_offset + in_scale * rotated;
+
+	vec3 pos = projection * view * vec3(fragPos, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
\ No newline at end of file
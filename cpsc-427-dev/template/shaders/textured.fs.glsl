@@ -9,10 +9,17 @@ uniform vec3 fcolor;
 
 // for mask
 in vec2 fragPos;
-uniform bool useMask;
-uniform vec2 playerPos;
-uniform float rBright;
-uniform float rDark;
+
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
 
 // Output color
 layout(location = 0) out  vec4 color;
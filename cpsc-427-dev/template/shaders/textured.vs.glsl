@@ -10,12 +10,22 @@ out vec2 fragPos;
 
 // Application data
 uniform mat3 transform;
-uniform mat3 projection;
-uniform mat3 view;
+uniform vec4 uv_rect; // the part of the atlas with the texture, (u0, v0, u1, v1)
+
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
 
 void main()
 {
-	texcoord = in_texcoord;
+	texcoord = mix(uv_rect.xy, uv_rect.zw, in_texcoord);
 	fragPos = vec2(transform * vec3(in_position.xy, 1.0));
 	
 	vec3 pos = projection * view * transform * vec3(in_position.xy, 1.0);
@@ -9,11 +9,22 @@ out vec2 texcoord;
 
 // Application data
 uniform mat3 transform;
-uniform mat3 projection;
+uniform vec4 uv_rect; // the part of the atlas with the texture, (u0, v0, u1, v1)
+
+// the data of the pass, shared by all the draws of a frame (FrameUniforms in render_system.hpp)
+layout(std140) uniform FrameUniforms
+{
+	mat3 projection;
+	mat3 view;
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	bool useMask;
+};
 
 void main()
 {
-	texcoord = in_texcoord;
+	texcoord = mix(uv_rect.xy, uv_rect.zw, in_texcoord);
 	vec3 pos = projection * transform * vec3(in_position.xy, 1.0);
 	gl_Position = vec4(pos.xy, in_position.z, 1.0);
 }
\ No newline at end of file
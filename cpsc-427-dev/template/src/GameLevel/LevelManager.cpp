@@ -30,7 +30,7 @@ LevelManager::~LevelManager()
 		Mix_FreeMusic(cover_bg_music);
 }
 
-void LevelManager::init(RenderSystem *renderer, GLFWwindow *window)
+void LevelManager::init(RenderSystem *renderer, GLFWwindow *window, ForceField *windField)
 {
 	// set renderer
 	this->renderer = renderer;
@@ -42,7 +42,7 @@ void LevelManager::init(RenderSystem *renderer, GLFWwindow *window)
 	levelCover.reset(new LevelCover(renderer, this, window));
 	levelTutorialPage.reset(new LevelTutorialPage(renderer, this, window));
 	levelSelection.reset(new LevelSelection(renderer, this, window));
-	levelPlay.reset(new LevelPlay(renderer, this, window));
+	levelPlay.reset(new LevelPlay(renderer, this, window, windField));
 
 	GoCover();
 	//GoLevelSelection();
@@ -121,6 +121,14 @@ void LevelManager::ResetRenderer()
 	while (registry.motions.entities.size() > 0)
 		registry.remove_all_components_of(registry.motions.entities.back());
 
+	// the sprite batches have no motion
+	while (registry.spriteBatches.entities.size() > 0)
+		registry.remove_all_components_of(registry.spriteBatches.entities.back());
+
+	// nor do the particles of the winds and the explosions
+	while (registry.particleBatches.entities.size() > 0)
+		registry.remove_all_components_of(registry.particleBatches.entities.back());
+
 	//while (registry.collisions.entities.size() > 0)
 	//	registry.remove_all_components_of(registry.collisions.entities.back());
 
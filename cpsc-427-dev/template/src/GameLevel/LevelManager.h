@@ -16,6 +16,7 @@ class LevelSelection;
 class LevelPlay;
 
 class RenderSystem;
+class ForceField;
 
 class LevelManager
 {
@@ -30,7 +31,7 @@ public:
 
 	~LevelManager();
 
-	void init(RenderSystem *renderer, GLFWwindow *window);
+	void init(RenderSystem *renderer, GLFWwindow *window, ForceField *windField);
 
 	// Steps the game ahead by ms milliseconds
 	void step(float elapsed_ms);
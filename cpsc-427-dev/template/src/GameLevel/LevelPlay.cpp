@@ -11,13 +11,14 @@ using namespace std;
 // Game configuration
 const size_t MAX_BUG = 5;
 const float PLAYER_SPEED = 200;
+const float DEBUG_STATS_INTERVAL_MS = 1000;
 
 
 int bot_to_top = 0;
 int left_to_right = 0;
 
-LevelPlay::LevelPlay(RenderSystem *renderer, LevelManager *manager, GLFWwindow *window) :GameLevel(renderer, manager, window)
-, next_bug_spawn(0.f)
+LevelPlay::LevelPlay(RenderSystem *renderer, LevelManager *manager, GLFWwindow *window, ForceField *windField) :GameLevel(renderer, manager, window)
+, windField(windField), next_bug_spawn(0.f), debug_stats_ms(0.f), print_debug_stats(false)
 {
 	// Reset the game speed
 	current_speed = 1.f;
@@ -66,7 +67,14 @@ void LevelPlay::step(float elapsed_ms)
 {
 	ProcessKeyPress();
 
-	UpdateWindParticle();
+	// a line of stats every frame would flood the console
+	debug_stats_ms += elapsed_ms;
+	print_debug_stats = debugging.in_debug_mode && debug_stats_ms >= DEBUG_STATS_INTERVAL_MS;
+	if (print_debug_stats)
+		debug_stats_ms = 0;
+
+	// decide which entities are simulated in this frame, by their distance to the player
+	lod.step(elapsed_ms, registry.motions.get(player).position);
 
 	UpdateBee(elapsed_ms / 1000.0f);
 
@@ -90,16 +98,31 @@ void LevelPlay::step(float elapsed_ms)
 
 	ai.step(elapsed_ms);
 
+	// the AI cost of this frame, to tune the AI frame budget
+	if (print_debug_stats && ai.GetQueueDepth() > 0)
+		cout << "AI: " << ai.GetFrameTimeUs() << " us, queue depth " << ai.GetQueueDepth() << endl;
+
+	// the draw calls of the last frame, the sprites are batched by texture and culled by the view.
+	// the fence waits are the frames so far that had to wait for the gpu to upload their sprites
+	if (print_debug_stats)
+		cout << "Render: " << renderer->GetDrawCallCount() << " draw calls, " << renderer->GetVisibleCount() << " visible, "
+			<< renderer->GetCulledCount() << " culled, " << renderer->GetFenceWaitCount() << " fence waits" << endl;
+
+	UpdateCrowd(elapsed_ms);
+
 	// update player velocity
 
 	Motion &player_motion = registry.motions.get(player);
-	Motion &guard_motion = registry.motions.get(guard);
 
 	player_motion.velocity.x = approach(player_motion.velocityGoal.x, player_motion.velocity.x, elapsed_ms);
 	player_motion.velocity.y = approach(player_motion.velocityGoal.y, player_motion.velocity.y, elapsed_ms);
 
-	guard_motion.velocity.x = approach(guard_motion.velocityGoal.x, guard_motion.velocity.x, elapsed_ms);
-	guard_motion.velocity.y = approach(guard_motion.velocityGoal.y, guard_motion.velocity.y, elapsed_ms);
+	for (Entity guardEntity : registry.guards.entities)
+	{
+		Motion &guard_motion = registry.motions.get(guardEntity);
+		guard_motion.velocity.x = approach(guard_motion.velocityGoal.x, guard_motion.velocity.x, elapsed_ms);
+		guard_motion.velocity.y = approach(guard_motion.velocityGoal.y, guard_motion.velocity.y, elapsed_ms);
+	}
 
 
 	// Remove debug info from the last step
@@ -180,19 +203,19 @@ void LevelPlay::step(float elapsed_ms)
 	// turn screen to grren
 	screen.greener_screen_factor = 1 - min_counter_ms / 3000;
 
-	// get the guard instance
-	auto &guardObj = registry.deadlys.get(guard);
-	auto &guardMotion = registry.motions.get(guard);
-	//printf("%f,%f\n", mo.position.x, mo.position.y);
 
 	// !!! TODO A1: update LightUp timers and remove if time drops below zero, similar to the death counter
 	for (Entity entity : registry.turnTimers.entities) {
 		TurnTimer &counter = registry.turnTimers.get(entity);
 		Motion &motion = registry.motions.get(entity);
 
-		if (counter.UpdateAndCheckIsTimeout(elapsed_ms))
+		float step_ms;
+		if (!lod_should_step(entity, elapsed_ms, step_ms))
+			continue;
+
+		if (counter.UpdateAndCheckIsTimeout(step_ms))
 		{
-			if (entity == guard)
+			if (registry.guards.has(entity))
 			{
 				motion.velocityGoal = { -1 * motion.velocityGoal[0] , motion.velocityGoal[1] }; // make the guard turn over
 
@@ -205,7 +228,16 @@ void LevelPlay::step(float elapsed_ms)
 		}
 	}
 
+	// the guards are only animated when they are simulated in this frame
+	for (Entity guardEntity : registry.guards.entities)
 	{
+		float guard_step_ms;
+		if (!lod_should_step(guardEntity, elapsed_ms, guard_step_ms))
+			continue;
+
+		auto &guardObj = registry.deadlys.get(guardEntity);
+		auto &guardMotion = registry.motions.get(guardEntity);
+
 		Character::Direction dir;
 		if (abs(guardMotion.velocity.x) >= abs(guardMotion.velocity.y)) {
 			if (guardMotion.velocity.x >= 0) // now the guard is moving right
@@ -224,7 +256,7 @@ void LevelPlay::step(float elapsed_ms)
 		guardObj.SwitchDirection(dir, glfwGetTime());
 
 		// update guard's appearance
-		registry.renderRequests.get(guard).used_texture = guardObj.GetTexId(glfwGetTime());
+		registry.renderRequests.get(guardEntity).used_texture = guardObj.GetTexId(glfwGetTime());
 	}
 
 	// the translation matrix is:
@@ -447,8 +479,9 @@ void LevelPlay::OnMouseButton(int button, int action, int mods)
 
 			cout << "clicked wall" << endl;
 
-			// store the walls that should be broken
+			// store the walls that should be broken, and their tiles
 			vector<Entity> shouldBreakWall;
+			vector<ivec2> brokenTiles;
 
 			auto &gameMap = registry.gameStates.get(manager->gameStateEntity).GetCurrentMap();
 			const int range = 3; // break range
@@ -463,19 +496,25 @@ void LevelPlay::OnMouseButton(int button, int action, int mods)
 						if (it2 != walls.end())
 						{
 							shouldBreakWall.push_back(it2->second);
+							brokenTiles.push_back(ivec2(j, i));
 							walls.erase(it2);
 						}
 					}
 				}
 
-			// remove walls
+			// remove walls, the renderer collapses their quads of the static layer
 			for (auto &wall : shouldBreakWall)
 			{
 				registry.remove_all_components_of(wall);
 			}
 
-			// add explode effects
-			createExplodeds(renderer, 40, vec2(col * WALL_SIZE, row * WALL_SIZE), vec2(WALL_SIZE), TEXTURE_ASSET_ID::WALL, 1500);
+			// the guards can walk through them now
+			ai.OnWallsRemoved(brokenTiles);
+			crowd.OnWallsRemoved(brokenTiles);
+
+			// add explode effects, the pieces move on the gpu so they only get the wind where they start
+			vec2 wallPos = vec2(col * WALL_SIZE, row * WALL_SIZE);
+			createExplodeds(explosionBatch, 40, wallPos, vec2(WALL_SIZE), 1500, windField->Sample(wallPos));
 
 			// remove this hammer
 			Entity hammer = *hoverHammer.begin();
@@ -874,10 +913,7 @@ void LevelPlay::if_clicked_bee_button(Entity entity)
 	vec2 beeBornPos(levelMap[0].size() * WALL_SIZE, levelMap.size() * WALL_SIZE);
 
 	// add bees
-	for (int i = 0; i < 10; ++i)
-	{
-		createBee(renderer, guard, beeBornPos);
-	}
+	swarm.Spawn(BEE_COUNT, beeBornPos);
 
 
 	// for guard
@@ -950,63 +986,51 @@ bool LevelPlay::GetClickedRowCol(vec2 cursor, int &row, int &col)
 	return false;
 }
 
-void LevelPlay::UpdateWindParticle()
+void LevelPlay::UpdateBee(float dt)
 {
-	// calc all the wind particles 's life and erase dead instance
-	for (auto &e : registry.windParticles.entities)
-	{
-		WindParticle &inst = registry.windParticles.get(e);
-		if (inst.IsAlive(glfwGetTime()) == false)
-		{
-			//cout << "-" << Wind::GetWindDirChar(inst.dir) << endl;
-
-			//
-			auto &wind = inst.windEntity;
-			if (registry.winds.has(wind))
-			{
-				registry.winds.get(wind).particleCount--;
-			}
-
-			registry.remove_all_components_of(e);
-			continue;
-		}
+	// the bees still fly home if the guard is gone
+	vec2 targetPos = registry.motions.has(guard) ? registry.motions.get(guard).position : vec2(0);
+	swarm.step(dt * 1000.0f, targetPos, *windField);
 
-		// if it's alive, update its position
-		auto &motion = registry.motions.get(e);
-		motion.position = inst.GetPos(glfwGetTime());
-	}
-
-	// add wind particles
+	if (registry.spriteBatches.has(beeBatch))
 	{
-		for (auto &wind : registry.winds.entities)
+		auto &positions = registry.spriteBatches.get(beeBatch).positions;
+		positions.resize(swarm.GetBeeCount());
+		for (int i = 0; i < swarm.GetBeeCount(); i++)
 		{
-			auto &inst = registry.winds.get(wind);
-			//cout << Wind::GetWindDirChar(inst.dir) << ":" << inst.particleCount << endl;
-			if (inst.particleCount < WIND_PARTICLE_LIMIT)
-			{
-				createWindParticle(renderer, inst, wind);
-				inst.particleCount++;
-				//cout << Wind::GetWindDirChar(inst.dir) << endl;
-			}
+			positions[i] = vec2(swarm.GetX()[i], swarm.GetY()[i]);
 		}
 	}
 }
 
-void LevelPlay::UpdateBee(float dt)
+void LevelPlay::UpdateCrowd(float elapsed_ms)
 {
-	auto &targetMotion = registry.motions.get(guard);
-	for (auto &e : registry.bees.entities)
+	// the students make way for the player and the guards
+	vector<vec2> obstaclePos, obstacleVel;
+	const Motion &player_motion = registry.motions.get(player);
+	obstaclePos.push_back(player_motion.position);
+	obstacleVel.push_back(player_motion.velocity);
+	for (Entity guardEntity : registry.guards.entities)
 	{
-		auto &motion = registry.motions.get(e);
-		auto &inst = registry.bees.get(e);
+		const Motion &guard_motion = registry.motions.get(guardEntity);
+		obstaclePos.push_back(guard_motion.position);
+		obstacleVel.push_back(guard_motion.velocity);
+	}
 
-		inst.ModifyMotion(dt, motion, targetMotion);
+	crowd.step(elapsed_ms, player_motion.position, obstaclePos, obstacleVel);
 
-		if (inst.IsAlive() == false)
+	if (registry.spriteBatches.has(crowdBatch))
+	{
+		auto &positions = registry.spriteBatches.get(crowdBatch).positions;
+		positions.resize(crowd.GetAgentCount());
+		for (int i = 0; i < crowd.GetAgentCount(); i++)
 		{
-			registry.remove_all_components_of(e);
+			positions[i] = vec2(crowd.GetX()[i], crowd.GetY()[i]);
 		}
 	}
+
+	if (print_debug_stats)
+		cout << "Crowd: " << crowd.GetStepUs() << " us, " << crowd.GetUpdatedCount() << "/" << crowd.GetAgentCount() << " agents updated on " << crowd.GetThreadCount() << " threads" << endl;
 }
 
 void LevelPlay::Restart()
@@ -1027,6 +1051,13 @@ void LevelPlay::Restart()
 	GameState &gameState = registry.gameStates.get(manager->gameStateEntity);
 	auto &level_map = gameState.GetCurrentMap();
 
+	// navigation grid for the guards
+	ai.Init(level_map);
+
+	// students wandering in the corridors, updated less often far from the player like the entities
+	crowd.Init(level_map, WALL_SIZE);
+	crowd.SetLodRadii(LODSystem::GetFullRadius(), LODSystem::GetReducedRadius());
+
 	float w = window_width_px;
 	float h = window_height_px;
 
@@ -1034,7 +1065,12 @@ void LevelPlay::Restart()
 	const vec2 &mapSize = gameState.GetMapPixelSize();
 	vec2 bgCenter = mapSize / 2.0f;
 	vec2 bgSize(mapSize.x + window_width_px, mapSize.y + window_height_px);
-	createBackground(renderer, bgCenter, bgSize, TEXTURE_ASSET_ID::FLOOR_BG);
+	Entity background = createBackground(renderer, bgCenter, bgSize, TEXTURE_ASSET_ID::FLOOR_BG);
+	registry.staticSprites.emplace(background);
+
+	// the winds fill theirs while the map is read
+	windBatch = createParticleBatch(TEXTURE_ASSET_ID::WIND_PARTICLE);
+	explosionBatch = createParticleBatch(TEXTURE_ASSET_ID::WALL);
 
 	// recreate entity
 	for (int row = 0; row < level_map.size(); row++) {
@@ -1112,7 +1148,8 @@ void LevelPlay::Restart()
 			}
 			else if (level_map[row][col] == '<' | level_map[row][col] == '>' | level_map[row][col] == '^' | level_map[row][col] == 'v')
 			{
-				createWind(renderer, { col * WALL_SIZE, row * WALL_SIZE }, WIND_WIDTH_SIZE, WIND_LENGTH_SIZE, Wind::GetWindDirByChar(level_map[row][col]));
+				Entity wind = createWind(renderer, { col * WALL_SIZE, row * WALL_SIZE }, WIND_WIDTH_SIZE, WIND_LENGTH_SIZE, Wind::GetWindDirByChar(level_map[row][col]));
+				createWindParticles(windBatch, registry.winds.get(wind));
 			}
 			else
 			{
@@ -1121,6 +1158,21 @@ void LevelPlay::Restart()
 		}
 	}
 
+	// the winds don't change after the level is loaded, the physics system only samples them
+	int cols = 0;
+	for (auto &row : level_map)
+		cols = glm::max(cols, (int)row.size());
+	windField->Build((int)level_map.size(), cols, WALL_SIZE);
+
+	// the floor and the walls are drawn from one vertex buffer
+	renderer->bakeStaticLayer();
+
+	crowdBatch = createSpriteBatch(TEXTURE_ASSET_ID::NPC_STUDENT, vec2(-CROWD_BB_SIZE, CROWD_BB_SIZE));
+
+	// no bees until the bee tool is used
+	swarm.Clear();
+	beeBatch = createSpriteBatch(TEXTURE_ASSET_ID::BEE, vec2(BEE_BB_SIZE));
+
 	// set saved state to 0, delete previous state
 	gameState.savedState = 0;
 
@@ -3,6 +3,10 @@
 
 #include "tiny_ecs.hpp"
 #include "ai_system.hpp"
+#include "lod_system.hpp"
+#include "crowd_system.hpp"
+#include "swarm_system.hpp"
+#include "force_field.hpp"
 
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
@@ -16,7 +20,7 @@ class LevelPlay :
 public:
 	Entity player;
 
-	LevelPlay(RenderSystem *renderer, LevelManager *manager, GLFWwindow *window);
+	LevelPlay(RenderSystem *renderer, LevelManager *manager, GLFWwindow *window, ForceField *windField);
 
 	virtual ~LevelPlay();
 
@@ -36,9 +40,17 @@ public:
 	virtual void OnMouseButton(int button, int action, int mods) override;
 private:
 	AISystem ai;
+	LODSystem lod;
+	CrowdSystem crowd;
+	SwarmSystem swarm;
+	ForceField *windField; // owned by the physics system
 
 	float current_speed;
 	float next_bug_spawn;
+
+	// the stats of the systems are printed once per DEBUG_STATS_INTERVAL_MS in debug mode
+	float debug_stats_ms;
+	bool print_debug_stats; // in this frame
 	int point;
 	bool displayed;
 
@@ -46,6 +58,10 @@ private:
 	Entity guard;
 	Entity exit;
 	Entity digit;
+	Entity crowdBatch; // the sprites of the crowd
+	Entity beeBatch; // the sprites of the bees
+	Entity windBatch; // the particles of the winds
+	Entity explosionBatch; // the pieces of the broken walls
 	std::set<Entity> hoverHammer; // stores the hovering hammer 
 	std::map<std::pair<int, int>, Entity> walls; // key={row,col}, value=Entity of wall
 
@@ -99,11 +115,11 @@ private:
 	// input a mouse cursor position, returns true, and make the row and col index of the clicked grid
 	bool GetClickedRowCol(vec2 cursor, int &row, int &col);
 
-	// add wind particles and remove dead wind particles
-	void UpdateWindParticle();
-
-	// 
+	// move the bees to the guard and copy them to their sprite batch
 	void UpdateBee(float dt);
+
+	// move the crowd around the player and the guards, and copy it to its sprite batch
+	void UpdateCrowd(float elapsed_ms);
 };
 
 // Interpolate
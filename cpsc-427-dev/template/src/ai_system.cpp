@@ -2,201 +2,342 @@
 #include "ai_system.hpp"
 
 #include "world_init.hpp"
+#include "lod_system.hpp"
 
+#include <climits>
 #include <iostream>
-#include <queue>
+#include <random>
 
 const float GUARD_VELOCITY = 100.0f;
-const float CALC_INTERVAL = 0.5f; // Calculate the shortest-path every 0.5 seconds
+const float CALC_INTERVAL = 0.5f; // a guard off the flow field calculates its own shortest-path at most every 0.5 seconds
+
+// a guard holding a path only searches again when it reached the end of it, when the player moved
+// this many tiles away from the goal of the path, or when the path is this old (seconds)
+const int PATH_GOAL_DRIFT = 3;
+const float PATH_MAX_AGE = 3.0f;
+
+// a waypoint is reached this close (pixels)
+const float PATH_ARRIVE_RADIUS = WALL_SIZE * 0.5f;
+
+// no wall is allowed within (GUARD_CLEARANCE - 1) tiles of the guard's path
+const int GUARD_CLEARANCE = 3;
+
+// tiles expanded by the flow field between two checks of the clock
+const int AI_SLICE_EXPANSIONS = 32;
+
+// waiting one more second is worth as much as being this many tiles closer to the player
+const float AI_WAIT_WEIGHT = 20.0f;
 
 using namespace std;
 
-// return validity of an index position
-inline bool PosIsValid(ivec2 pos, int rows, int cols)
+void AISystem::Init(const vector<vector<char>> &levelMap)
 {
-	return 0 <= pos.y && pos.y < rows && 0 <= pos.x && pos.x < cols;
+	navGrid.Build(levelMap);
+
+	flowFields[0].Init(navGrid);
+	flowFields[1].Init(navGrid);
+	readyField = 0;
+
+	useHierarchy = navGrid.GetSize() >= AI_HPA_MIN_TILES;
+
+	// the results of the previous level are dropped with its worker
+	worker.Start(levelMap, GUARD_CLEARANCE, navGrid.GetVersion());
+	searchesInFlight = 0;
+	pendingWalls.clear();
+
+	lastFrameUs = 0;
+	lastQueueDepth = 0;
 }
 
-// manhattan distance
-inline int Distance(ivec2 a, ivec2 b)
+ivec2 AISystem::ToTile(vec2 position)
 {
-	return abs(a.x - b.x) + abs(a.y - b.y);
+	// entities are placed at (col * WALL_SIZE, row * WALL_SIZE), so round to the nearest tile
+	return ivec2(floor(position / WALL_SIZE + 0.5f));
 }
 
-// Node for calculating shortest-path
-struct Node
+// the guard follows the path of a search from its second waypoint, the first one is where it started
+void AISystem::StartFollowing(Guard &guardAI, PathFollower &follower, const PathResult &result)
 {
-	ivec2 pos; // current position
-	int distToTarget; // the distance to target
-
-	bool isStart; // is the second Node
-	ivec2 firstDir; // start direction
-	Node() {}
-	Node(ivec2 pos, int distToTarget, bool isStart, ivec2 firstDir) :pos(pos), distToTarget(distToTarget), isStart(isStart), firstDir(firstDir) {}
-	bool operator<(const Node &other) const
-	{
-		return distToTarget < other.distToTarget;
-	}
-	bool operator>(const Node &other) const
+	follower.waypoints.clear();
+	for (ivec2 tile : result.path)
+		follower.waypoints.push_back(vec2(tile) * WALL_SIZE);
+	follower.next = 1;
+	follower.goalTile = result.goal;
+
+	if (!follower.HasPath())
 	{
-		return distToTarget > other.distToTarget;
+		// already there or nowhere to go, walk to a random direction
+		uniform_int_distribution<int> pick(0, 7);
+		guardAI.chaseVector = normalize(vec2(NAV_NEIGHBOURS[pick(eng)]));
 	}
-};
+}
+
+// the direction to the next waypoint, after skipping the ones already reached
+vec2 AISystem::SteerAlongPath(PathFollower &follower, vec2 position, vec2 current)
+{
+	while (follower.HasPath() && distance(position, follower.waypoints[follower.next]) < PATH_ARRIVE_RADIUS)
+		follower.next++;
+
+	if (!follower.HasPath())
+		return current;
+	return normalize(follower.waypoints[follower.next] - position);
+}
 
-// return true if there is a wall at the neighbor of pos 
-// 
-//   e.g. [ ][W][ ][P]     return true if range==2; return false if range==1
-// 
-bool hasWallAtNeighbor(const vector<vector<char>> &levelMap, ivec2 pos, int range)
+void AISystem::SubmitGuardSearches(ivec2 playerTile)
 {
-	int rows = levelMap.size();
-	int cols = levelMap[0].size();
-	for (int i = std::max(0, pos.y - range); i < std::min(rows, pos.y + range); ++i)
+	while (searchesInFlight < AI_MAX_SEARCHES_IN_FLIGHT)
 	{
-		for (int j = std::max(0, pos.x - range); j < std::min(cols, pos.x + range); ++j)
+		// the queued guard with the best (lowest) priority
+		int best = -1;
+		float bestPriority = 0;
+		for (uint i = 0; i < registry.guards.size(); ++i)
 		{
-			if (levelMap[i][j] == 'W')
-				return true;
+			const Guard &guardAI = registry.guards.components[i];
+			if (!guardAI.planQueued)
+				continue;
+
+			ivec2 guardTile = ToTile(registry.motions.get(registry.guards.entities[i]).position);
+			float priority = length(vec2(guardTile - playerTile)) - AI_WAIT_WEIGHT * guardAI.sinceLastPlan;
+			if (best < 0 || priority < bestPriority)
+			{
+				best = i;
+				bestPriority = priority;
+			}
 		}
+		if (best < 0)
+			return;
+
+		Entity guard = registry.guards.entities[best];
+		ivec2 guardTile = ToTile(registry.motions.get(guard).position);
+		if (!worker.SubmitFind((unsigned int)guard, guardTile, playerTile, navGrid.GetVersion()))
+			return; // the job queue is full, try again next frame
+
+		Guard &guardAI = registry.guards.components[best];
+		guardAI.planQueued = false;
+		guardAI.planPending = true;
+		searchesInFlight++;
 	}
-	return false;
 }
 
-// calculate the chase vector by BFS
-vec2 calcChaseVectorV1(const vector<vector<char>> &levelMap, ivec2 guardPos, ivec2 targetPos)
+void AISystem::ReadSearchResults()
 {
-	vector<vector<char>> temp = levelMap;
-	int rows = levelMap.size();
-	int cols = levelMap[0].size();
-	guardPos = clamp(guardPos, { 0,0 }, { cols,rows });
-	targetPos = clamp(targetPos, { 0,0 }, { cols,rows });
-
-	vector<vector<char>> visited = vector<vector<char>>(rows, vector<char>(cols));
-	queue<Node> q;
-	q.push(Node(guardPos, Distance(guardPos, targetPos), true, ivec2(0)));
-	//visited[playerPos.y][playerPos.x] = 1;
-
-	// 
-	const vector<ivec2> directions = { ivec2(1,0),ivec2(-1,0),ivec2(0,1),ivec2(0,-1), ivec2(-1,-1),ivec2(-1,1),ivec2(1,-1),ivec2(1,1) };
-	int searchNum = 0;
-
-	Node cur;
-	while (!q.empty())
+	for (PathResult *result = worker.PeekResult(); result != nullptr; result = worker.PeekResult())
 	{
-		searchNum++;
-		cur = q.front();
-		auto curPos = cur.pos;
-		if (curPos == targetPos)
-			break;
-
-		q.pop();
+		searchesInFlight--;
 
-		// if visited
-		if (visited[curPos.y][curPos.x])
-			continue;
-
-		visited[curPos.y][curPos.x] = 1;
+		// the guard may have been removed while its search was in flight
+		int found = -1;
+		for (uint i = 0; i < registry.guards.size() && found < 0; ++i)
+		{
+			if ((unsigned int)registry.guards.entities[i] == result->guardId)
+				found = i;
+		}
 
-		// for all the directions
-		for (auto dir : directions)
+		if (found >= 0)
 		{
-			ivec2 newPos = curPos + dir;
-			if (PosIsValid(newPos, rows, cols) && visited[newPos.y][newPos.x] == 0 && levelMap[newPos.y][newPos.x] == ' ')
+			Entity guard = registry.guards.entities[found];
+			Guard *guardAI = &registry.guards.components[found];
+			guardAI->planPending = false;
+			if (result->mapVersion != navGrid.GetVersion())
 			{
-				if (hasWallAtNeighbor(levelMap, newPos, 3))
-					continue;
-
-				ivec2 firstDir;
-				if (cur.isStart)
-					firstDir = dir; // record the start direction
-				else
-					firstDir = cur.firstDir; // equals to the start direction
-				q.push(Node(newPos, Distance(newPos, targetPos), false, firstDir));
+				// searched on walls that were broken since, it may miss a shorter way. the guard
+				// keeps its current path meanwhile, it's still valid
+				guardAI->planQueued = true;
+			}
+			else
+			{
+				StartFollowing(*guardAI, registry.pathFollowers.get(guard), *result);
+				guardAI->sinceLastPlan = 0;
+
+				// guards far away from the player are replanned less often
+				switch (lod_get_tier(guard))
+				{
+				case SimTier::FULL: guardAI->replanRemain = CALC_INTERVAL; break;
+				case SimTier::REDUCED: guardAI->replanRemain = CALC_INTERVAL * 2.0f; break;
+				case SimTier::FROZEN: guardAI->replanRemain = CALC_INTERVAL * 4.0f; break;
+				}
 			}
 		}
+
+		worker.PopResult();
 	}
-	//cur.firstDir.y = -cur.firstDir.y;
-	vec2 chaseVector = normalize(vec2(cur.firstDir));
+}
+
+void AISystem::SubmitPendingWalls()
+{
+	if (!pendingWalls.empty() && worker.SubmitRemoveWalls(pendingWalls, navGrid.GetVersion()))
+		pendingWalls.clear();
+}
 
-	if (chaseVector.x != chaseVector.x)
+void AISystem::RunScheduler(ivec2 playerTile, chrono::steady_clock::time_point start)
+{
+	if (useHierarchy)
+		return;
+
+	// start a new flow field when the player moved to another tile. a build in flight is
+	// finished first, otherwise a running player would never get a field
+	FlowField &building = flowFields[1 - readyField];
+	if (!building.IsBuilding() && !flowFields[readyField].IsFor(playerTile, GUARD_CLEARANCE))
+		building.Begin(playerTile, GUARD_CLEARANCE);
+
+	while (building.IsBuilding())
 	{
-		srand(glfwGetTime());
-		chaseVector = normalize(vec2(directions[ rand() % directions.size()]));
+		if (building.Step(AI_SLICE_EXPANSIONS))
+		{
+			readyField = 1 - readyField; // guards read the new field from now on
+			break;
+		}
+		if (chrono::duration<float, micro>(chrono::steady_clock::now() - start).count() >= frameBudgetUs)
+			break;
 	}
-
-	// print
-	// cout << "Search Nums=" << searchNum << endl;
-	// cout << "Chase Vector=(" << chaseVector.x << "," << chaseVector.y << ")" << endl;
-	return chaseVector;
 }
 
+int AISystem::CountQueue() const
+{
+	const FlowField &building = flowFields[1 - readyField];
+	int depth = building.IsBuilding() ? 1 : 0;
+	for (const Guard &guardAI : registry.guards.components)
+	{
+		if (guardAI.planQueued || guardAI.planPending)
+			depth++;
+	}
+	return depth;
+}
 
 void AISystem::step(float elapsed_ms)
 {
 	if (enable == false)
 		return;
 
-	// trigger the trap effect, guards will start to chase the player with the shortest path
-	// TODO: currently, the shortest path is guard move toward the player directly that will ignore wall, which need to be changed
-	if (registry.trappables.size() > 0) {
+	auto start = chrono::steady_clock::now();
 
-		// refresh 
-		if (remainWaitTime <= 0) {
+	Entity player = registry.players.entities[0];
+	vec2 playerPos = registry.motions.get(player).position;
+	ivec2 playerTile = ToTile(playerPos);
+
+	// a guard that sees the player stops its patrol and chases it
+	perception.step(navGrid, playerPos);
+	bool anyChasing = false;
+	for (uint i = 0; i < registry.guards.size(); ++i)
+	{
+		Entity guard = registry.guards.entities[i];
+		Guard &guardAI = registry.guards.components[i];
+		if (!guardAI.chasing && registry.sights.has(guard) && registry.sights.get(guard).seesPlayer)
+		{
+			guardAI.chasing = true;
+			if (registry.turnTimers.has(guard))
+				registry.turnTimers.remove(guard); // guard will not be turning around
+		}
+		anyChasing = anyChasing || guardAI.chasing;
+	}
+
+	// trigger the trap effect, guards will start to chase the player with the shortest path
+	bool trapped = registry.trappables.size() > 0;
+	if (!trapped && !anyChasing)
+	{
+		lastFrameUs = chrono::duration<float, micro>(chrono::steady_clock::now() - start).count();
+		return;
+	}
 
-			//debugging.in_debug_mode = true;
+	SubmitPendingWalls();
+	ReadSearchResults();
+	RunScheduler(playerTile, start);
 
-			cout << "AISystem::step  " << "update chasing" << endl;
+	const FlowField &flowField = flowFields[readyField];
+	for (uint i = 0; i < registry.guards.size(); ++i)
+	{
+		Entity guard = registry.guards.entities[i];
+		Guard &guardAI = registry.guards.components[i];
+		if (!trapped && !guardAI.chasing)
+			continue; // still on its patrol
 
-			// get entity
-			Entity player = registry.players.entities[0];
-			Entity guard = registry.guards.entities[0];
+		Motion &guard_motion = registry.motions.get(guard);
 
-			// get their motion
-			Motion &player_motion = registry.motions.get(player);
-			Motion &guard_motion = registry.motions.get(guard);
+		guardAI.replanRemain -= elapsed_ms / 1000.0f;
+		guardAI.sinceLastPlan += elapsed_ms / 1000.0f;
 
+		ivec2 guardTile = ToTile(guard_motion.position);
+		PathFollower &follower = registry.pathFollowers.get(guard);
+		ivec2 flowDir;
+		if (flowField.GetDirection(guardTile, flowDir) && flowDir != ivec2(0))
+		{
+			guardAI.chaseVector = normalize(vec2(flowDir));
+			guardAI.planQueued = false;
+			follower.waypoints.clear();
+			follower.next = 0;
+		}
+		else
+		{
+			// not on the field (too close to a wall, or the player can't be reached): it follows its own path
+			guardAI.chaseVector = SteerAlongPath(follower, guard_motion.position, guardAI.chaseVector);
 
-			//ivec2 vectorChaseIndex=calcChaseVector()
-			Entity gameStateEntity = registry.gameStates.entities[0];
-			GameState &gameState = registry.gameStates.get(gameStateEntity);
+			bool replan = !follower.HasPath() || guardAI.sinceLastPlan >= PATH_MAX_AGE ||
+				NavGrid::Chebyshev(follower.goalTile, playerTile) > PATH_GOAL_DRIFT;
+			if (replan && guardAI.replanRemain <= 0 && !guardAI.planPending)
+				guardAI.planQueued = true; // it keeps its current path until the result comes back
+		}
 
-			// calculate the chase vector
-			ivec2 playerPosIndex = player_motion.position / vec2(WALL_SIZE, WALL_SIZE);
-			ivec2 guardPosIndex=guard_motion.position / vec2(WALL_SIZE, WALL_SIZE);
-			vec2 vector_chase = calcChaseVectorV1(gameState.GetCurrentMap(), guardPosIndex, playerPosIndex);
+		vec2 vector_chase = guardAI.chaseVector;
+		if (vector_chase == vec2(0))
+			continue; // no plan yet
 
-			Character::Direction dir;
-			auto &guardObj = registry.deadlys.get(guard);
-			if (abs(vector_chase.x) > abs(vector_chase.y)) {
-				if (vector_chase.x > 0) {
-					dir = Character::Direction::RIGHT;
-				}
-				else {
-					dir = Character::Direction::LEFT;
-				}
+		Character::Direction dir;
+		auto &guardObj = registry.deadlys.get(guard);
+		if (abs(vector_chase.x) > abs(vector_chase.y)) {
+			if (vector_chase.x > 0) {
+				dir = Character::Direction::RIGHT;
 			}
 			else {
-				if (vector_chase.y > 0) {
-					dir = Character::Direction::DOWN;
-				}
-				else {
-					dir = Character::Direction::UP;
-				}
+				dir = Character::Direction::LEFT;
+			}
+		}
+		else {
+			if (vector_chase.y > 0) {
+				dir = Character::Direction::DOWN;
 			}
+			else {
+				dir = Character::Direction::UP;
+			}
+		}
 
+		guardObj.SwitchDirection(dir, glfwGetTime());
 
-			guardObj.SwitchDirection(dir, glfwGetTime());
+		// update the velocity of guard
+		guard_motion.velocityGoal = vector_chase * GUARD_VELOCITY;
+	}
 
-			// update the velocity and angle of guard
-			//guard_motion.angle = atan2(vector_chase.y, vector_chase.x);
-			guard_motion.velocityGoal = vector_chase * GUARD_VELOCITY;
+	SubmitGuardSearches(playerTile);
 
-			remainWaitTime = CALC_INTERVAL;
-		}
-		else
-		{
-			remainWaitTime -= elapsed_ms / 1000.0f;
-		}
+	lastQueueDepth = CountQueue();
+	lastFrameUs = chrono::duration<float, micro>(chrono::steady_clock::now() - start).count();
+}
+
+void AISystem::OnWallsRemoved(const vector<ivec2> &tiles)
+{
+	ivec2 changedBegin, changedEnd;
+	if (!navGrid.RemoveWalls(tiles, changedBegin, changedEnd))
+		return;
+
+	// the field the guards read is repaired at once, a build in flight continues with the new walls
+	FlowField &ready = flowFields[readyField];
+	if (ready.IsDone())
+	{
+		ready.Repair(changedBegin, changedEnd);
+		ready.Step(INT_MAX);
+	}
+	FlowField &building = flowFields[1 - readyField];
+	if (building.IsBuilding())
+		building.Repair(changedBegin, changedEnd);
+
+	// the worker gets the same walls, the results searched before them are dropped when they come back
+	pendingWalls.insert(pendingWalls.end(), tiles.begin(), tiles.end());
+	SubmitPendingWalls();
+
+	// the guards on their own paths may have a shorter way now, their paths are as old as a path can get
+	for (Guard &guardAI : registry.guards.components)
+	{
+		guardAI.replanRemain = 0;
+		guardAI.sinceLastPlan = glm::max(guardAI.sinceLastPlan, PATH_MAX_AGE);
 	}
 }
 
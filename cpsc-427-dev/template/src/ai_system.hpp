@@ -1,23 +1,105 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 
 #include "tiny_ecs_registry.hpp"
 #include "common.hpp"
+#include "nav_grid.hpp"
+#include "flow_field.hpp"
+#include "path_worker.hpp"
+#include "perception_system.hpp"
 
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 // DON'T WORRY ABOUT THIS CLASS UNTIL ASSIGNMENT 3
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
+// default time (microseconds) the AI can spend on the flow field in one frame
+const float AI_FRAME_BUDGET_US = 1000.0f;
+
+// guard searches submitted to the worker and not answered yet, the others wait in priority order
+const int AI_MAX_SEARCHES_IN_FLIGHT = 4;
+
 class GameState;
+
+/*
+* a guard starts to chase the player when it sees it (PerceptionSystem), all the guards chase
+* once a trap was triggered.
+*
+* guards chase the player by a shared flow field, a guard that is not on the field gets its own search
+* (jump point search on a bit-packed grid).
+*
+* the flow field toward the player's new tile is time-sliced: it's built in a second buffer over
+* several frames, in small slices until the frame budget is used up, and guards read the old one meanwhile.
+*
+* the guard searches run on the PathWorker thread. the queued guards are submitted in priority order
+* (closer to the player and longer since its last plan is better), a few at a time. the paths come
+* back smoothed to a few waypoints, the guard steers to the next one every frame (PathFollower) and
+* keeps its path until a new one comes back, so it only searches again when the path runs out, the
+* player moved away from its goal or the path got old. a result searched on walls that were broken since
+* is dropped and the guard is queued again.
+*
+* on big levels a full-grid field or A* costs too much, the worker searches the HPA* graph
+* instead and only refines the path through the guard's current cluster.
+*/
 class AISystem
 {
 public:
-	AISystem(){}
+	AISystem() :enable(true), frameBudgetUs(AI_FRAME_BUDGET_US), lastFrameUs(0), lastQueueDepth(0), useHierarchy(false), readyField(0), searchesInFlight(0) {}
+
+	// build the navigation grid of a level, call it when the level is (re)loaded
+	void Init(const std::vector<std::vector<char>> &levelMap);
+
 	void step(float elapsed_ms);
 
+	// walls were broken (tiles as (col, row)), only the region around them is recomputed
+	void OnWallsRemoved(const std::vector<ivec2> &tiles);
+
 	void SetEnable(bool enable);
+
+	// the time (microseconds) the flow field can use per frame, at least one slice is done every frame
+	void SetFrameBudget(float us) { frameBudgetUs = us; }
+	float GetFrameBudget() const { return frameBudgetUs; }
+
+	const PerceptionSystem &GetPerception() const { return perception; }
+
+	// time (microseconds) spent in the last step(), and the number of searches waiting or in flight after it
+	float GetFrameTimeUs() const { return lastFrameUs; }
+	int GetQueueDepth() const { return lastQueueDepth; }
+
 private:
 	bool enable;
-	float remainWaitTime; // initialized to be 0. when calculated, to be a number, means shouldn't refresh after a while.
-};
\ No newline at end of file
+
+	float frameBudgetUs;
+	float lastFrameUs;
+	int lastQueueDepth;
+
+	NavGrid navGrid;
+	PerceptionSystem perception;
+
+	// big level: no flow field, the worker searches the HPA* graph
+	bool useHierarchy;
+
+	// toward the player, shared by all the chasing guards. guards read flowFields[readyField],
+	// the other one is built when the player changed tile
+	FlowField flowFields[2];
+	int readyField;
+
+	// the guard searches
+	PathWorker worker;
+	int searchesInFlight;
+	std::vector<ivec2> pendingWalls; // broken walls the worker's job queue had no room for yet
+
+	// build the flow field until the budget is used, start is when this frame's AI began
+	void RunScheduler(ivec2 playerTile, std::chrono::steady_clock::time_point start);
+	void SubmitGuardSearches(ivec2 playerTile);
+	void ReadSearchResults();
+	void SubmitPendingWalls();
+
+	int CountQueue() const;
+
+	static void StartFollowing(Guard &guardAI, PathFollower &follower, const PathResult &result);
+	static vec2 SteerAlongPath(PathFollower &follower, vec2 position, vec2 current);
+
+	static ivec2 ToTile(vec2 position);
+};
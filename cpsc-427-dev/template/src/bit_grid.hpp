@@ -0,0 +1,85 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// index of the lowest / highest set bit, the value must not be 0
+inline int bit_lowest(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (int)index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+inline int bit_highest(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+/*
+* one bit per tile, row-major. every row starts on a new 64-bit word, bit (x & 63) of word
+* (x >> 6) is column x. the bits after the end of a row are always 0, so a scan along a row
+* stops there like at a wall.
+*/
+class BitGrid
+{
+public:
+	BitGrid() :rows(0), cols(0), wordsPerRow(0) {}
+
+	// all the bits are cleared
+	void Resize(int rows, int cols)
+	{
+		this->rows = rows;
+		this->cols = cols;
+		wordsPerRow = (cols + 63) / 64;
+		bits.assign(rows * wordsPerRow, 0);
+	}
+
+	int GetRows() const { return rows; }
+	int GetCols() const { return cols; }
+	int GetWordsPerRow() const { return wordsPerRow; }
+
+	// false outside of the grid
+	bool Get(int x, int y) const
+	{
+		if (x < 0 || x >= cols || y < 0 || y >= rows)
+			return false;
+		return (bits[y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	void Set(int x, int y, bool value)
+	{
+		uint64_t &word = bits[y * wordsPerRow + (x >> 6)];
+		uint64_t mask = (uint64_t)1 << (x & 63);
+		word = value ? (word | mask) : (word & ~mask);
+	}
+
+	// the words of a row, nullptr outside of the grid
+	const uint64_t *GetRow(int y) const
+	{
+		if (y < 0 || y >= rows)
+			return nullptr;
+		return &bits[y * wordsPerRow];
+	}
+
+private:
+	int rows;
+	int cols;
+	int wordsPerRow;
+	std::vector<uint64_t> bits;
+};
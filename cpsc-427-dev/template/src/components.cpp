@@ -422,46 +422,6 @@ bool TurnTimer::UpdateAndCheckIsTimeout(float elapsed_ms)
 	return false;
 }
 
-WindParticle::WindParticle(const Wind &parentWind, const Entity &windEntity, float t0) :windEntity(windEntity)
-{
-	//   vx in [length/5.0, length/1.0]
-//   A  in [0.1*width, 0.5*width]
-//   T  in [0.1*length, 2.0*length]
-	this->t0 = t0;
-	pos0 = parentWind.pos;
-
-	uniform_real_distribution<float> uniVx(parentWind.length / 5.0f, parentWind.length / 1.0f);
-	v = uniVx(eng);
-
-	uniform_real_distribution<float> uniA(parentWind.width * 0.1f, parentWind.width * 1.0f);
-	A = uniA(eng);
-
-	uniform_real_distribution<float> uniT(parentWind.length * 0.01f, parentWind.length * 1.0f);
-	T = uniT(eng);
-
-	parentLength = parentWind.length;
-	dir = parentWind.dir;
-}
-
-bool WindParticle::IsAlive(float t) const
-{
-	return v * (t - t0) < parentLength;
-}
-
-vec2 WindParticle::GetPos(float t) const
-{
-	vec2 diffPos;
-	float sign = -1;
-	if (dir == Direction::RIGHT || dir == Direction::DOWN)
-		sign = 1;
-	diffPos.x = sign * v * (t - t0);
-	diffPos.y = A * sin(2.0 * M_PI / T * (t - t0));
-
-	if (dir == Direction::UP || dir == Direction::DOWN)
-		swap(diffPos.x, diffPos.y);
-	return pos0 + diffPos;
-}
-
 bool Wind::InRange(vec2 objPos) const
 {
 	vec2 xRangeDiff(-length, 0);
@@ -482,23 +442,18 @@ bool Wind::InRange(vec2 objPos) const
 	return inRange;
 }
 
-void Wind::Influence(Motion &motion) const
+vec2 Wind::GetFlowVelocity() const
 {
-	if (InRange(motion.position) == false)
-		return;
-
 	float sign = -1;
 	if (dir == Direction::RIGHT || dir == Direction::DOWN)
 		sign = 1;
 
-	vec2 vGoal = { sign * 100.0f,0 };
+	vec2 flow = { sign * WIND_SPEED,0 };
 	if (dir == Direction::UP || dir == Direction::DOWN)
 	{
-		swap(vGoal.x, vGoal.y);
+		swap(flow.x, flow.y);
 	}
-
-	motion.velocityGoal = vGoal;
-	cout << "flowing" << endl;
+	return flow;
 }
 
 Direction Wind::GetWindDirByChar(char c)
@@ -528,87 +483,3 @@ char Wind::GetWindDirChar(Direction dir)
 	}
 	return c;
 }
-
-Bee::Bee(const Entity &targetEntity, vec2 diffPosWithTarget, vec2 bornPos) :usedTime(0), targetEntity(targetEntity),
-diffPosWithTarget(diffPosWithTarget),
-bornPos(bornPos),
-goingTime(BEE_GOING_TIME),
-stayTime(BEE_STAY_TIME),
-leaveTime(BEE_LEAVE_TIME)
-{
-
-	uniform_real_distribution<float> uniA(WALL_SIZE * 0.1f, WALL_SIZE * 2.0f);
-	A = uniA(eng);
-
-	uniform_real_distribution<float> uniT(0.1f, 1.0f);
-	T = uniT(eng);
-}
-
-Bee::State Bee::GetState() const
-{
-	// current: go for chasing target
-	if (usedTime < goingTime)
-	{
-		return State::GOING;
-	}
-
-	// current: floating on the target
-	if (usedTime < goingTime + stayTime)
-	{
-		return State::STAY;
-	}
-
-	// current: leave the target
-	if (usedTime < goingTime + stayTime + leaveTime)
-	{
-		return State::LEAVE;
-	}
-	assert(0);
-	return State();
-}
-
-void Bee::ModifyMotion(float dt, Motion &beeMotion, const Motion &targetMotion)
-{
-	assert(IsAlive());
-
-	// current: go for chasing target
-	if (usedTime < goingTime)
-	{
-		float remainTime = goingTime - usedTime; // the remaining time for the bees to chase the target
-		vec2 remainJourney = (targetMotion.position+diffPosWithTarget) - beeMotion.position;
-		beeMotion.position += remainJourney * (dt / remainTime);
-
-		usedTime += dt;
-		return;
-	}
-
-	// current: floating on the target
-	if (usedTime < goingTime + stayTime)
-	{
-		float remainTime = goingTime +stayTime - usedTime; // the remaining time for the bees to stay
-		beeMotion.position = (targetMotion.position + diffPosWithTarget);
-
-		// y diff
-		float yDiff = A * sin(2.0f*M_PI/T * usedTime);
-		beeMotion.position.y += yDiff;
-
-		usedTime += dt;
-		return;
-	}
-
-	// current: leave the target
-	if (usedTime < goingTime + stayTime + leaveTime)
-	{
-		float remainTime = goingTime + stayTime+leaveTime - usedTime; // the remaining time for the bees to leave
-		vec2 remainJourney = bornPos - beeMotion.position;
-		beeMotion.position += remainJourney * (dt / remainTime);
-
-		usedTime += dt;
-		return;
-	}
-}
-
-bool Bee::IsAlive() const
-{
-	return usedTime <= (goingTime + stayTime + leaveTime);
-}
@@ -80,7 +80,35 @@ private:
 
 struct Guard
 {
+	vec2 chaseVector = { 0, 0 }; // the direction the guard is chasing to
+	float replanRemain = 0; // seconds before the guard can run its own path search again
+	float sinceLastPlan = 0; // seconds since its own path search finished
+	bool planQueued = false; // waiting to be submitted to the path worker
+	bool planPending = false; // its search was submitted, the result didn't come back yet
+	bool chasing = false; // saw the player, it chases even if no trap was triggered
+};
+
+// the waypoints of a smoothed path, the AISystem steers the guard to the next one every frame
+struct PathFollower
+{
+	std::vector<vec2> waypoints; // positions in pixels, the first one is where the path started
+	uint next = 0; // the waypoint the guard walks to
+	ivec2 goalTile = { 0, 0 }; // the player's tile when the path was searched
+
+	bool HasPath() const { return next < waypoints.size(); }
+};
 
+// what a guard sees, refreshed by the PerceptionSystem every frame
+struct Sight
+{
+	bool seesPlayer = false;
+	vec2 facing = { -1, 0 }; // the direction the guard looks to, the last direction it moved to
+
+	// the last ray to the player, reused while both ends stay on the same tiles and the walls don't change
+	ivec2 rayFrom = { 0, 0 };
+	ivec2 rayTo = { 0, 0 };
+	unsigned int rayMapVersion = 0; // 0: no ray yet
+	bool rayClear = false;
 };
 
 // Eagles have a hard shell
@@ -165,6 +193,21 @@ struct Motion {
     }
 };
 
+// how often an entity is simulated, decided by its distance to the player
+enum class SimTier { FULL, REDUCED, FROZEN };
+
+// simulation level of detail, refreshed by the LODSystem at the beginning of every frame
+struct SimLod
+{
+	SimTier tier;
+	bool catchUp; // true: the time skipped while frozen is simulated when it is promoted again
+	bool stepThisFrame; // false: skip the updates of this entity in this frame
+	float step_ms; // when stepThisFrame, the time to simulate (includes the skipped frames)
+	float pending_ms; // the time that is not simulated yet
+
+	SimLod(bool catchUp) :tier(SimTier::FULL), catchUp(catchUp), stepThisFrame(true), step_ms(0), pending_ms(0) {}
+};
+
 // Stucture to store collision information
 struct Collision
 {
@@ -298,13 +341,10 @@ struct Background {
 
 };
 
-// this struct is used for exploding
-struct Exploded
-{
-	float life; // decrease every loop
-	float initLife;
-	vec2 initSize;
-	Exploded(float life,vec2 initSize) :life(life),initLife(life),initSize(initSize) {}
+// a sprite that never moves (the walls, the floor of a level). it is baked with the others into the
+// static layer of the renderer instead of being drawn on its own, its color is not used
+struct StaticSprite {
+
 };
 
 /*
@@ -325,13 +365,12 @@ struct Wind
 	float width; // the width of wind
 	float length; // the length of wind
 	Direction dir;
-	int particleCount;
-	Wind(vec2 pos, float width, float length, Direction dir) :pos(pos), width(width), length(length), dir(dir), particleCount(0) {}
+	Wind(vec2 pos, float width, float length, Direction dir) :pos(pos), width(width), length(length), dir(dir) {}
 
 	bool InRange(vec2 objPos) const;
 
-	// make a motion be influence by this wind
-	void Influence(Motion &motion) const;
+	// the velocity this wind pushes things along with
+	vec2 GetFlowVelocity() const;
 
 	// get a direction by a character that "<>v^" means left/right/down/up
 	static Direction GetWindDirByChar(char c);
@@ -339,49 +378,6 @@ struct Wind
 };
 
 
-struct WindParticle
-{
-private:
-	float t0; // born time
-	vec2 pos0; // born position
-	float v; // velocity at flowing direction
-	float A; // amplitude of sin curve
-	float T; // period of sin curve
-	float parentLength;
-public:
-	Entity windEntity;
-	Direction dir;
-	WindParticle(const Wind &parentWind, const Entity &windEntity, float t0);
-
-	// x = x0 + v * t
-	// y = y0 + A sin(2*pi/T * t)
-	vec2 GetPos(float t) const;
-	bool IsAlive(float t) const;
-};
-
-struct Bee
-{
-private:
-	float usedTime;
-	vec2 diffPosWithTarget;
-	vec2 bornPos;
-	float goingTime;
-	float stayTime;
-	float leaveTime;
-	float A;// amplitude of sin curve
-	float T; // period of sin curve
-public:
-	Entity targetEntity; // the target purchased by bee
-	enum class State{GOING,STAY,LEAVE};
-	//State state;
-
-	Bee(const Entity &targetEntity, vec2 diffPosWithTarget, vec2 bornPos);
-
-	State GetState() const;
-	void ModifyMotion(float dt, Motion &beeMotion, const Motion &targetMotion);
-	bool IsAlive() const;
-};
-
 /**
  * The following enumerators represent global identifiers refering to graphic
  * assets. For example TEXTURE_ASSET_ID are the identifiers of each texture
@@ -522,7 +518,9 @@ enum class EFFECT_ASSET_ID {
 	WIND = EGG+1,
 	TEXTURED = WIND+1,
 	UI= TEXTURED +1,
-	EFFECT_COUNT = UI + 1
+	SPRITE_BATCH = UI + 1,
+	PARTICLE = SPRITE_BATCH + 1,
+	EFFECT_COUNT = PARTICLE + 1
 };
 const int effect_count = (int)EFFECT_ASSET_ID::EFFECT_COUNT;
 
@@ -531,25 +529,80 @@ enum class GEOMETRY_BUFFER_ID {
 	DEBUG_LINE = BUG + 1,
 	SCREEN_TRIANGLE = DEBUG_LINE + 1,
 	SPRITE = SCREEN_TRIANGLE + 1,
-	GEOMETRY_COUNT = SPRITE + 1
+	STATIC_LAYER = SPRITE + 1, // the static sprites, baked by RenderSystem::bakeStaticLayer()
+	GEOMETRY_COUNT = STATIC_LAYER + 1
 };
 const int geometry_count = (int)GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
 
+// the layers of the world pass, from the bottom to the top. see RenderQueue for the order in a layer
+enum class RENDER_LAYER {
+	BACKGROUND = 0,
+	GROUND = BACKGROUND + 1,
+	ACTORS = GROUND + 1,
+	CROWD = ACTORS + 1,
+	EFFECTS = CROWD + 1,
+	DEBUG = EFFECTS + 1,
+	UI = DEBUG + 1,
+	LAYER_COUNT = UI + 1
+};
+const int render_layer_count = (int)RENDER_LAYER::LAYER_COUNT;
+
 struct RenderRequest {
 	TEXTURE_ASSET_ID used_texture = TEXTURE_ASSET_ID::TEXTURE_COUNT;
 	EFFECT_ASSET_ID used_effect = EFFECT_ASSET_ID::EFFECT_COUNT;
 	GEOMETRY_BUFFER_ID used_geometry = GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
 	bool showOnMinimap;
+	RENDER_LAYER layer = RENDER_LAYER::ACTORS;
 
 	void changeTexture(TEXTURE_ASSET_ID newTexture) {
 		used_texture = newTexture;
 	}
 
-	RenderRequest(TEXTURE_ASSET_ID used_texture, EFFECT_ASSET_ID used_effect, GEOMETRY_BUFFER_ID used_geometry, bool showOnMinimap) :
+	RenderRequest(TEXTURE_ASSET_ID used_texture, EFFECT_ASSET_ID used_effect, GEOMETRY_BUFFER_ID used_geometry, bool showOnMinimap, RENDER_LAYER layer = RENDER_LAYER::ACTORS) :
 		used_texture(used_texture),
 		used_effect(used_effect),
 		used_geometry(used_geometry),
-		showOnMinimap(showOnMinimap)
+		showOnMinimap(showOnMinimap),
+		layer(layer)
 	{}
 };
 
+// many copies of one sprite, drawn together. for the crowds that are too big to be entities,
+// their own system fills the positions every frame
+struct SpriteBatch
+{
+	TEXTURE_ASSET_ID texture = TEXTURE_ASSET_ID::TEXTURE_COUNT;
+	vec2 scale = { 1, 1 };
+	std::vector<vec2> positions;
+};
+
+// one particle, read by the particle shader that moves it from its age in seconds:
+//   position = origin + velocity * age + wave * sin(frequency * age)
+//   angle = angle + spin * age, scale = size * (1 - shrink * age / life)
+// a looping particle starts again every life seconds, the amplitude and the period of its wave are
+// drawn again every time from its seed. the fields go to the shader 4 floats at a time
+struct Particle
+{
+	vec2 origin;
+	vec2 velocity;
+	vec2 wave;
+	float frequency;
+	float seed; // [0, 1)
+	vec2 size;
+	float angle;
+	float spin;
+	float birth; // glfwGetTime()
+	float life;
+	float shrink;
+	float loop; // 1 for a looping particle
+};
+
+// particles that move on their own, nothing is done for them on the cpu after they are added.
+// the renderer uploads them again when dirty
+struct ParticleBatch
+{
+	TEXTURE_ASSET_ID texture = TEXTURE_ASSET_ID::TEXTURE_COUNT;
+	std::vector<Particle> particles;
+	bool dirty = true;
+};
+
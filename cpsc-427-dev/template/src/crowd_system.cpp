@@ -0,0 +1,513 @@
+// internal
+#include "crowd_system.hpp"
+
+#include <chrono>
+#include <glm/geometric.hpp>
+
+using namespace std;
+using glm::vec2;
+using glm::ivec2;
+
+// an agent that was not updated for a while doesn't move further than this at once
+const float CROWD_MAX_STEP_MS = 250.0f;
+
+// agents per chunk of the parallel loops
+const int CROWD_MIN_CHUNK = 64;
+
+const float CROWD_EPSILON = 1e-5f;
+
+// velocities on the left of the line are allowed (the line goes along direction through point)
+struct OrcaLine
+{
+	vec2 point;
+	vec2 direction;
+};
+
+const int CROWD_MAX_LINES = CROWD_MAX_NEIGHBOURS + CROWD_MAX_OBSTACLES;
+
+static uint32_t NextRandom(uint32_t &state)
+{
+	// xorshift32
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static float Det(vec2 a, vec2 b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+// the half-plane of velocities that avoid the other body for CROWD_TIME_HORIZON, when this agent
+// takes `responsibility` of the avoidance (half for agents, all of it for obstacles)
+static OrcaLine MakeOrcaLine(vec2 velocity, vec2 relPos, vec2 relVel, float combinedRadius, float dt, float responsibility)
+{
+	const float invTimeHorizon = 1.0f / CROWD_TIME_HORIZON;
+	float distSq = dot(relPos, relPos);
+	float combinedRadiusSq = combinedRadius * combinedRadius;
+
+	OrcaLine line;
+	vec2 u;
+	if (distSq > combinedRadiusSq)
+	{
+		// w goes from the center of the cut-off circle to the relative velocity
+		vec2 w = relVel - invTimeHorizon * relPos;
+		float wLengthSq = dot(w, w);
+		float dotProduct1 = dot(w, relPos);
+
+		if (dotProduct1 < 0 && dotProduct1 * dotProduct1 > combinedRadiusSq * wLengthSq)
+		{
+			// closest to the cut-off circle
+			float wLength = sqrt(wLengthSq);
+			vec2 unitW = w / wLength;
+			line.direction = vec2(unitW.y, -unitW.x);
+			u = (combinedRadius * invTimeHorizon - wLength) * unitW;
+		}
+		else
+		{
+			// closest to one of the legs of the cone
+			float leg = sqrt(distSq - combinedRadiusSq);
+			if (Det(relPos, w) > 0)
+				line.direction = vec2(relPos.x * leg - relPos.y * combinedRadius, relPos.x * combinedRadius + relPos.y * leg) / distSq;
+			else
+				line.direction = -vec2(relPos.x * leg + relPos.y * combinedRadius, -relPos.x * combinedRadius + relPos.y * leg) / distSq;
+
+			u = dot(relVel, line.direction) * line.direction - relVel;
+		}
+	}
+	else
+	{
+		// already overlapping: get apart within this step
+		float invTimeStep = 1.0f / dt;
+		vec2 w = relVel - invTimeStep * relPos;
+		float wLength = length(w);
+		vec2 unitW = wLength > CROWD_EPSILON ? w / wLength : vec2(1, 0);
+		line.direction = vec2(unitW.y, -unitW.x);
+		u = (combinedRadius * invTimeStep - wLength) * unitW;
+	}
+
+	line.point = velocity + responsibility * u;
+	return line;
+}
+
+// the velocity on line lineNo, within the speed circle and the lines before it, closest to optVelocity
+// (or as far as possible in its direction). false if there is none
+static bool LinearProgram1(const OrcaLine *lines, int lineNo, float radius, vec2 optVelocity, bool directionOpt, vec2 &result)
+{
+	const OrcaLine &line = lines[lineNo];
+	float dotProduct = dot(line.point, line.direction);
+	float discriminant = dotProduct * dotProduct + radius * radius - dot(line.point, line.point);
+	if (discriminant < 0)
+		return false;
+
+	float sqrtDiscriminant = sqrt(discriminant);
+	float tLeft = -dotProduct - sqrtDiscriminant;
+	float tRight = -dotProduct + sqrtDiscriminant;
+
+	for (int i = 0; i < lineNo; ++i)
+	{
+		float denominator = Det(line.direction, lines[i].direction);
+		float numerator = Det(lines[i].direction, line.point - lines[i].point);
+
+		if (fabs(denominator) <= CROWD_EPSILON)
+		{
+			// parallel lines
+			if (numerator < 0)
+				return false;
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if (denominator >= 0)
+			tRight = min(tRight, t);
+		else
+			tLeft = max(tLeft, t);
+
+		if (tLeft > tRight)
+			return false;
+	}
+
+	float t;
+	if (directionOpt)
+		t = dot(optVelocity, line.direction) > 0 ? tRight : tLeft;
+	else
+		t = glm::clamp(dot(line.direction, optVelocity - line.point), tLeft, tRight);
+
+	result = line.point + t * line.direction;
+	return true;
+}
+
+// the velocity allowed by all the lines closest to optVelocity. return the number of lines, or the
+// first line that could not be satisfied
+static int LinearProgram2(const OrcaLine *lines, int count, float radius, vec2 optVelocity, bool directionOpt, vec2 &result)
+{
+	if (directionOpt)
+		result = optVelocity * radius;
+	else if (dot(optVelocity, optVelocity) > radius * radius)
+		result = normalize(optVelocity) * radius;
+	else
+		result = optVelocity;
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (Det(lines[i].direction, lines[i].point - result) > 0)
+		{
+			vec2 previous = result;
+			if (!LinearProgram1(lines, i, radius, optVelocity, directionOpt, result))
+			{
+				result = previous;
+				return i;
+			}
+		}
+	}
+	return count;
+}
+
+// no velocity is allowed by all the lines (a dense crowd): take the one that violates them the least
+static void LinearProgram3(const OrcaLine *lines, int count, int beginLine, float radius, vec2 &result)
+{
+	OrcaLine projLines[CROWD_MAX_LINES];
+	float distance = 0;
+
+	for (int i = beginLine; i < count; ++i)
+	{
+		if (Det(lines[i].direction, lines[i].point - result) <= distance)
+			continue;
+
+		int projCount = 0;
+		for (int j = 0; j < i; ++j)
+		{
+			OrcaLine line;
+			float determinant = Det(lines[i].direction, lines[j].direction);
+			if (fabs(determinant) <= CROWD_EPSILON)
+			{
+				// parallel lines in the same direction don't limit the other
+				if (dot(lines[i].direction, lines[j].direction) > 0)
+					continue;
+				line.point = 0.5f * (lines[i].point + lines[j].point);
+			}
+			else
+			{
+				line.point = lines[i].point + (Det(lines[j].direction, lines[i].point - lines[j].point) / determinant) * lines[i].direction;
+			}
+			line.direction = normalize(lines[j].direction - lines[i].direction);
+			projLines[projCount++] = line;
+		}
+
+		vec2 previous = result;
+		if (LinearProgram2(projLines, projCount, radius, vec2(-lines[i].direction.y, lines[i].direction.x), true, result) < projCount)
+			result = previous;
+
+		distance = Det(lines[i].direction, lines[i].point - result);
+	}
+}
+
+void CrowdSystem::Init(const NavGrid::LevelMap &levelMap, float tileSize, int agentCount, unsigned int seed)
+{
+	Clear();
+	this->tileSize = tileSize;
+	grid.Build(levelMap);
+
+	vector<int> walkable;
+	for (int i = 0; i < grid.GetSize(); ++i)
+	{
+		if (grid.IsWalkable(i))
+			walkable.push_back(i);
+	}
+	if (walkable.empty())
+		return;
+
+	uint32_t state = seed != 0 ? seed : 1;
+	for (int d = 0; d < CROWD_DESTINATION_COUNT; ++d)
+	{
+		fields[d].Init(grid);
+		fields[d].Build(grid.ToPos(walkable[NextRandom(state) % walkable.size()]), 1);
+	}
+
+	// spawn where the first destination can be reached, so no agent starts in a closed room
+	vector<int> spawns;
+	for (int index : walkable)
+	{
+		if (fields[0].GetCost(grid.ToPos(index)) >= 0)
+			spawns.push_back(index);
+	}
+
+	if (agentCount < 0)
+		agentCount = (int)walkable.size() / CROWD_TILES_PER_AGENT;
+	agentCount = glm::min(agentCount, CROWD_MAX_AGENTS);
+
+	posX.resize(agentCount);
+	posY.resize(agentCount);
+	velX.assign(agentCount, 0);
+	velY.assign(agentCount, 0);
+	newVelX.assign(agentCount, 0);
+	newVelY.assign(agentCount, 0);
+	pendingMs.assign(agentCount, 0);
+	stepS.assign(agentCount, 0);
+	destination.assign(agentCount, CROWD_DESTINATION_COUNT);
+	rng.resize(agentCount);
+
+	for (int i = 0; i < agentCount; ++i)
+	{
+		rng[i] = NextRandom(state) | 1;
+
+		// a little off the tile center, so agents on the same tile don't overlap exactly
+		vec2 tile = vec2(grid.ToPos(spawns[NextRandom(state) % spawns.size()]));
+		vec2 offset = vec2(NextRandom(state) % 1000, NextRandom(state) % 1000) / 1000.0f - 0.5f;
+		vec2 pos = (tile + offset * 0.5f) * tileSize;
+		posX[i] = pos.x;
+		posY[i] = pos.y;
+
+		PickDestination(i);
+	}
+
+	// cells as big as the neighbour distance, a query looks at 3x3 cells at most
+	vec2 origin = vec2(-0.5f * tileSize);
+	int cols = (int)ceil(grid.GetCols() * tileSize / CROWD_NEIGHBOUR_DIST);
+	int rows = (int)ceil(grid.GetRows() * tileSize / CROWD_NEIGHBOUR_DIST);
+	agentGrid.Init(origin, CROWD_NEIGHBOUR_DIST, cols, rows);
+}
+
+void CrowdSystem::Clear()
+{
+	posX.clear();
+	posY.clear();
+	velX.clear();
+	velY.clear();
+	newVelX.clear();
+	newVelY.clear();
+	pendingMs.clear();
+	stepS.clear();
+	destination.clear();
+	rng.clear();
+	frameIndex = 0;
+	updatedCount = 0;
+	stepUs = 0;
+}
+
+void CrowdSystem::SetLodRadii(float fullRadius, float reducedRadius)
+{
+	this->fullRadius = fullRadius;
+	this->reducedRadius = glm::max(reducedRadius, fullRadius);
+}
+
+void CrowdSystem::OnWallsRemoved(const vector<ivec2> &tiles)
+{
+	ivec2 changedBegin, changedEnd;
+	if (posX.empty() || !grid.RemoveWalls(tiles, changedBegin, changedEnd))
+		return;
+
+	for (FlowField &field : fields)
+	{
+		field.Repair(changedBegin, changedEnd);
+		while (!field.Step(grid.GetSize()));
+	}
+}
+
+bool CrowdSystem::IsWalkable(vec2 pos) const
+{
+	ivec2 tile = ToTile(pos);
+	return grid.IsValid(tile) && grid.IsWalkable(grid.ToIndex(tile));
+}
+
+void CrowdSystem::PickDestination(int agent)
+{
+	ivec2 tile = ToTile(vec2(posX[agent], posY[agent]));
+	int first = NextRandom(rng[agent]) % CROWD_DESTINATION_COUNT;
+	for (int k = 0; k < CROWD_DESTINATION_COUNT; ++k)
+	{
+		int d = (first + k) % CROWD_DESTINATION_COUNT;
+		if (d != destination[agent] && fields[d].GetCost(tile) > 1)
+		{
+			destination[agent] = (uint8_t)d;
+			return;
+		}
+	}
+	if (destination[agent] >= CROWD_DESTINATION_COUNT)
+		destination[agent] = 0;
+}
+
+vec2 CrowdSystem::PreferredVelocity(int agent) const
+{
+	vec2 pos(posX[agent], posY[agent]);
+	ivec2 tile = ToTile(pos);
+	ivec2 dir;
+	if (!fields[destination[agent]].GetDirection(tile, dir) || dir == ivec2(0))
+		return vec2(0);
+
+	// toward the center of the next tile
+	vec2 toNext = vec2(tile + dir) * tileSize - pos;
+	float length = glm::length(toNext);
+	return length > CROWD_EPSILON ? toNext * (CROWD_MAX_SPEED / length) : vec2(0);
+}
+
+void CrowdSystem::ComputeVelocity(int agent)
+{
+	float dt = stepS[agent];
+	if (dt <= 0)
+		return;
+
+	vec2 pos(posX[agent], posY[agent]);
+	vec2 vel(velX[agent], velY[agent]);
+
+	// the closest neighbours, sorted by distance
+	int neighbours[CROWD_MAX_NEIGHBOURS];
+	float neighbourDistSq[CROWD_MAX_NEIGHBOURS];
+	int neighbourCount = 0;
+	const float rangeSq = CROWD_NEIGHBOUR_DIST * CROWD_NEIGHBOUR_DIST;
+
+	agentGrid.QueryRadius(pos, CROWD_NEIGHBOUR_DIST, [&](int other) {
+		if (other == agent)
+			return;
+		vec2 delta = vec2(posX[other], posY[other]) - pos;
+		float distSq = dot(delta, delta);
+		if (distSq >= rangeSq)
+			return;
+
+		int k;
+		if (neighbourCount < CROWD_MAX_NEIGHBOURS)
+			k = neighbourCount++;
+		else if (distSq >= neighbourDistSq[CROWD_MAX_NEIGHBOURS - 1])
+			return;
+		else
+			k = CROWD_MAX_NEIGHBOURS - 1;
+
+		for (; k > 0 && neighbourDistSq[k - 1] > distSq; --k)
+		{
+			neighbours[k] = neighbours[k - 1];
+			neighbourDistSq[k] = neighbourDistSq[k - 1];
+		}
+		neighbours[k] = other;
+		neighbourDistSq[k] = distSq;
+	});
+
+	OrcaLine lines[CROWD_MAX_LINES];
+	int lineCount = 0;
+
+	// the player and the guards don't avoid the agents, the agents take all the avoidance
+	const float obstacleRange = CROWD_NEIGHBOUR_DIST + CROWD_OBSTACLE_RADIUS;
+	for (size_t i = 0; i < obstaclePos.size() && lineCount < CROWD_MAX_OBSTACLES; ++i)
+	{
+		vec2 relPos = obstaclePos[i] - pos;
+		if (dot(relPos, relPos) >= obstacleRange * obstacleRange)
+			continue;
+		lines[lineCount++] = MakeOrcaLine(vel, relPos, vel - obstacleVel[i], CROWD_AGENT_RADIUS + CROWD_OBSTACLE_RADIUS, dt, 1.0f);
+	}
+
+	for (int k = 0; k < neighbourCount; ++k)
+	{
+		int other = neighbours[k];
+		vec2 relPos = vec2(posX[other], posY[other]) - pos;
+		vec2 relVel = vel - vec2(velX[other], velY[other]);
+		lines[lineCount++] = MakeOrcaLine(vel, relPos, relVel, 2 * CROWD_AGENT_RADIUS, dt, 0.5f);
+	}
+
+	vec2 newVel;
+	int lineFail = LinearProgram2(lines, lineCount, CROWD_MAX_SPEED, PreferredVelocity(agent), false, newVel);
+	if (lineFail < lineCount)
+		LinearProgram3(lines, lineCount, lineFail, CROWD_MAX_SPEED, newVel);
+
+	newVelX[agent] = newVel.x;
+	newVelY[agent] = newVel.y;
+}
+
+void CrowdSystem::Move(int agent)
+{
+	float dt = stepS[agent];
+	if (dt <= 0)
+		return;
+
+	vec2 pos(posX[agent], posY[agent]);
+	vec2 vel(newVelX[agent], newVelY[agent]);
+	vec2 next = pos + vel * dt;
+
+	// slide along the walls
+	if (!IsWalkable(next))
+	{
+		if (IsWalkable(vec2(next.x, pos.y)))
+		{
+			next.y = pos.y;
+			vel.y = 0;
+		}
+		else if (IsWalkable(vec2(pos.x, next.y)))
+		{
+			next.x = pos.x;
+			vel.x = 0;
+		}
+		else
+		{
+			next = pos;
+			vel = vec2(0);
+		}
+	}
+
+	posX[agent] = next.x;
+	posY[agent] = next.y;
+	velX[agent] = vel.x;
+	velY[agent] = vel.y;
+
+	// arrived, or the destination can't be reached from here
+	ivec2 dir;
+	if (!fields[destination[agent]].GetDirection(ToTile(next), dir) || dir == ivec2(0))
+		PickDestination(agent);
+}
+
+void CrowdSystem::step(float elapsed_ms, vec2 playerPos, const vector<vec2> &obstaclePos, const vector<vec2> &obstacleVel)
+{
+	auto startTime = chrono::high_resolution_clock::now();
+
+	int count = GetAgentCount();
+	updatedCount = 0;
+	if (count == 0)
+	{
+		stepUs = 0;
+		return;
+	}
+
+	this->obstaclePos = obstaclePos;
+	this->obstacleVel = obstacleVel;
+	this->obstacleVel.resize(obstaclePos.size(), vec2(0));
+
+	// level of detail: the agents far from the player are updated every few frames, in turns
+	float fullSq = fullRadius * fullRadius;
+	float reducedSq = reducedRadius * reducedRadius;
+	for (int i = 0; i < count; ++i)
+	{
+		pendingMs[i] += elapsed_ms;
+
+		int interval = 1;
+		if (fullRadius > 0)
+		{
+			vec2 delta = vec2(posX[i], posY[i]) - playerPos;
+			float distSq = dot(delta, delta);
+			interval = distSq <= fullSq ? 1 : distSq <= reducedSq ? CROWD_REDUCED_INTERVAL : CROWD_FAR_INTERVAL;
+		}
+
+		if ((frameIndex + i) % interval == 0)
+		{
+			stepS[i] = glm::min(pendingMs[i], CROWD_MAX_STEP_MS) / 1000.0f;
+			pendingMs[i] = 0;
+			updatedCount++;
+		}
+		else
+		{
+			stepS[i] = 0;
+		}
+	}
+	frameIndex++;
+
+	agentGrid.Build(posX.data(), posY.data(), count);
+
+	// every agent reads the old positions and velocities of its neighbours, then they all move
+	parallel.Run(count, CROWD_MIN_CHUNK, [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			ComputeVelocity(i);
+	});
+	parallel.Run(count, CROWD_MIN_CHUNK, [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			Move(i);
+	});
+
+	stepUs = chrono::duration<float, micro>(chrono::high_resolution_clock::now() - startTime).count();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "flow_field.hpp"
+#include "spatial_grid.hpp"
+#include "parallel_for.hpp"
+
+// destinations the students walk to, every one has its flow field built when the level is loaded
+const int CROWD_DESTINATION_COUNT = 8;
+
+// by default one student for this many walkable tiles
+const int CROWD_TILES_PER_AGENT = 24;
+const int CROWD_MAX_AGENTS = 4000;
+
+// pixels and pixels per second
+const float CROWD_AGENT_RADIUS = 10.0f;
+const float CROWD_OBSTACLE_RADIUS = 25.0f; // the player and the guards
+const float CROWD_MAX_SPEED = 60.0f;
+
+// an agent avoids its CROWD_MAX_NEIGHBOURS closest neighbours within CROWD_NEIGHBOUR_DIST,
+// for the collisions that would happen in the next CROWD_TIME_HORIZON seconds
+const float CROWD_NEIGHBOUR_DIST = 50.0f;
+const int CROWD_MAX_NEIGHBOURS = 8;
+const int CROWD_MAX_OBSTACLES = 4;
+const float CROWD_TIME_HORIZON = 1.0f;
+
+// agents further than the full / reduced LOD radius are updated once every this many frames
+const int CROWD_REDUCED_INTERVAL = 4;
+const int CROWD_FAR_INTERVAL = 16;
+
+/*
+* students wandering the corridors, as cover for the player
+*
+* the agents are not entities: there can be thousands, so they live in flat arrays here (one array
+* per field) and are drawn as one SpriteBatch. every agent walks to one of a few destinations by
+* its cached flow field, and picks another one when it arrives. the agents avoid each other (and
+* the player and the guards) with ORCA: every neighbour found in the uniform grid forbids a
+* half-plane of velocities, and the allowed velocity closest to the flow field's one is found by a
+* small linear program. walls are handled by the flow field and by sliding along them.
+*
+* a frame builds the grid, then computes the new velocities and moves the agents in two parallel
+* loops. agents far from the player are updated less often, with the time they skipped.
+*/
+class CrowdSystem
+{
+public:
+	CrowdSystem() :tileSize(1), fullRadius(0), reducedRadius(0), frameIndex(0), updatedCount(0), stepUs(0) {}
+
+	// build the navigation of a level and spawn the agents on random walkable tiles.
+	// agentCount < 0: one agent every CROWD_TILES_PER_AGENT walkable tiles
+	void Init(const NavGrid::LevelMap &levelMap, float tileSize, int agentCount = -1, unsigned int seed = 1);
+
+	// remove all the agents
+	void Clear();
+
+	// agents further than these distances (pixels) from the player are updated less often
+	void SetLodRadii(float fullRadius, float reducedRadius);
+
+	// walls were broken (tiles as (col, row))
+	void OnWallsRemoved(const std::vector<glm::ivec2> &tiles);
+
+	// obstacles are bodies the agents avoid without pushing them (the player and the guards)
+	void step(float elapsed_ms, glm::vec2 playerPos, const std::vector<glm::vec2> &obstaclePos, const std::vector<glm::vec2> &obstacleVel);
+
+	int GetAgentCount() const { return (int)posX.size(); }
+	const std::vector<float> &GetX() const { return posX; }
+	const std::vector<float> &GetY() const { return posY; }
+
+	// agents updated by the last step, and the time it took (microseconds)
+	int GetUpdatedCount() const { return updatedCount; }
+	float GetStepUs() const { return stepUs; }
+	int GetThreadCount() const { return parallel.GetThreadCount(); }
+
+private:
+	float tileSize;
+	float fullRadius;
+	float reducedRadius;
+	unsigned int frameIndex;
+	int updatedCount;
+	float stepUs;
+
+	NavGrid grid;
+	FlowField fields[CROWD_DESTINATION_COUNT];
+
+	// one entry per agent
+	std::vector<float> posX, posY;
+	std::vector<float> velX, velY;
+	std::vector<float> newVelX, newVelY;
+	std::vector<float> pendingMs; // time not simulated yet
+	std::vector<float> stepS; // time simulated in this frame (seconds), 0 if not updated
+	std::vector<uint8_t> destination;
+	std::vector<uint32_t> rng; // xorshift state
+
+	UniformGrid agentGrid;
+	std::vector<glm::vec2> obstaclePos, obstacleVel;
+
+	ParallelFor parallel;
+
+	glm::ivec2 ToTile(glm::vec2 pos) const { return glm::ivec2(glm::floor(pos / tileSize + 0.5f)); }
+	bool IsWalkable(glm::vec2 pos) const;
+
+	// pick a destination the agent can reach from its tile, keep the old one if none
+	void PickDestination(int agent);
+
+	glm::vec2 PreferredVelocity(int agent) const;
+	void ComputeVelocity(int agent);
+	void Move(int agent);
+};
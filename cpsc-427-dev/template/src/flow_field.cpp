@@ -0,0 +1,134 @@
+// internal
+#include "flow_field.hpp"
+
+#include <cassert>
+#include <climits>
+
+using namespace std;
+using glm::ivec2;
+
+void FlowField::Init(const NavGrid &grid)
+{
+	this->grid = &grid;
+
+	int size = grid.GetSize();
+	cost.assign(size, -1.0f);
+	direction.assign(size, -1);
+	open.Init(size);
+
+	started = false;
+	done = false;
+	expandedCount = 0;
+}
+
+bool FlowField::IsPassable(int index, ivec2 pos) const
+{
+	if (grid->GetClearance(index) >= clearance)
+		return true;
+	return grid->IsWalkable(index) && NavGrid::Chebyshev(pos, goal) < clearance;
+}
+
+void FlowField::Build(ivec2 goal, int clearance)
+{
+	Begin(goal, clearance);
+	Step(INT_MAX);
+}
+
+void FlowField::Begin(ivec2 goal, int clearance)
+{
+	assert(grid != nullptr && (int)cost.size() == grid->GetSize() && "FlowField::Init() not called");
+
+	this->goal = grid->Clamp(goal);
+	this->clearance = clearance;
+	started = true;
+	done = false;
+	expandedCount = 0;
+
+	std::fill(cost.begin(), cost.end(), -1.0f);
+	std::fill(direction.begin(), direction.end(), (int8_t)-1);
+	open.Clear();
+
+	int goalIndex = grid->ToIndex(this->goal);
+	cost[goalIndex] = 0;
+	open.Push(goalIndex, 0);
+}
+
+bool FlowField::Step(int maxExpansions)
+{
+	// dijkstra from the goal, moves are symmetric so the reversed edges have the same cost
+	for (int n = 0; n < maxExpansions && !open.Empty(); ++n)
+	{
+		int cur = open.Pop();
+		expandedCount++;
+
+		ivec2 curPos = grid->ToPos(cur);
+		bool passable[8];
+		for (int d = 0; d < 8; ++d)
+		{
+			ivec2 newPos = curPos + NAV_NEIGHBOURS[d];
+			passable[d] = grid->IsValid(newPos) && IsPassable(grid->ToIndex(newPos), newPos);
+			if (d >= 4)
+				passable[d] = passable[d] && passable[NAV_DIAGONAL_SIDES[d][0]] && passable[NAV_DIAGONAL_SIDES[d][1]];
+			if (!passable[d])
+				continue;
+
+			int next = grid->ToIndex(newPos);
+			float c = cost[cur] + NAV_STEP_COST[d];
+			if (cost[next] >= 0 && c >= cost[next])
+				continue;
+
+			// from next, the way to the goal is the opposite move back to cur.
+			// a closed tile is only improved after a Repair(), it's opened again
+			cost[next] = c;
+			direction[next] = (int8_t)(d ^ 1);
+			if (open.Contains(next))
+				open.Decrease(next, c);
+			else
+				open.Push(next, c);
+		}
+	}
+
+	done = open.Empty();
+	return done;
+}
+
+void FlowField::Repair(ivec2 changedBegin, ivec2 changedEnd)
+{
+	if (!started)
+		return;
+
+	// the moves into the changed tiles start from their neighbours, so open one more tile around
+	ivec2 begin = glm::max(changedBegin - 1, ivec2(0));
+	ivec2 end = glm::min(changedEnd + 1, ivec2(grid->GetCols(), grid->GetRows()));
+	for (int y = begin.y; y < end.y; ++y)
+	{
+		for (int x = begin.x; x < end.x; ++x)
+		{
+			int index = grid->ToIndex(ivec2(x, y));
+			if (cost[index] >= 0 && !open.Contains(index))
+				open.Push(index, cost[index]);
+		}
+	}
+
+	done = open.Empty();
+}
+
+bool FlowField::GetDirection(ivec2 pos, ivec2 &dir) const
+{
+	if (!done || !grid->IsValid(pos))
+		return false;
+
+	int index = grid->ToIndex(pos);
+	if (cost[index] < 0)
+		return false;
+
+	dir = direction[index] < 0 ? ivec2(0) : NAV_NEIGHBOURS[direction[index]];
+	return true;
+}
+
+float FlowField::GetCost(ivec2 pos) const
+{
+	if (!done || !grid->IsValid(pos))
+		return -1.0f;
+	return cost[grid->ToIndex(pos)];
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "index_heap.hpp"
+
+/*
+* a dijkstra flow field toward one goal tile (the player), shared by all the chasing guards
+*
+* Build() runs dijkstra from the goal over the whole grid and stores two fields:
+*   integration field - the path cost (in tiles) from every tile to the goal
+*   direction field   - the neighbour to step to from every tile, on a shortest path to the goal
+* then any number of agents can read their next step in O(1). the field only has to be built
+* again when the goal moves to another tile.
+*
+* the passability is the same as PathSearch: clearance >= the asked clearance, relaxed to
+* walkable near the goal. tiles that can't reach the goal have no direction.
+*
+* a build can be split over several frames with Begin() and Step(), the fields can only be
+* read when it is done. when walls are removed, Repair() only recomputes the tiles whose cost goes down.
+*/
+class FlowField
+{
+public:
+	FlowField() :grid(nullptr), goal(-1), clearance(0), started(false), done(false), expandedCount(0) {}
+
+	// allocate the buffers for a grid, the field is empty until it is built
+	void Init(const NavGrid &grid);
+
+	// compute the fields toward the goal tile at once
+	void Build(glm::ivec2 goal, int clearance);
+
+	// start a build toward the goal tile, then call Step() until it returns true
+	void Begin(glm::ivec2 goal, int clearance);
+
+	// expand at most maxExpansions tiles, return true when the build is done
+	bool Step(int maxExpansions);
+
+	// a build was started (or is done) toward this goal with this clearance
+	bool IsFor(glm::ivec2 goal, int clearance) const { return started && this->goal == goal && this->clearance == clearance; }
+
+	// tiles in [changedBegin, changedEnd) became passable (walls removed), update the fields.
+	// costs can only go down, so the reached tiles around the change are opened again and the
+	// dijkstra continues from them; call Step() until it returns true
+	void Repair(glm::ivec2 changedBegin, glm::ivec2 changedEnd);
+
+	bool IsDone() const { return done; }
+	bool IsBuilding() const { return started && !done; }
+
+	// the next step from pos, (0,0) at the goal. return false if the goal can't be reached from pos
+	bool GetDirection(glm::ivec2 pos, glm::ivec2 &dir) const;
+
+	// path cost from pos to the goal in tiles, negative if the goal can't be reached
+	float GetCost(glm::ivec2 pos) const;
+
+	// number of tiles expanded by the last build
+	int GetExpandedCount() const { return expandedCount; }
+
+private:
+	const NavGrid *grid;
+	glm::ivec2 goal;
+	int clearance;
+	bool started;
+	bool done;
+	int expandedCount;
+
+	std::vector<float> cost;      // integration field, < 0 for unreached tiles
+	std::vector<int8_t> direction; // index in NAV_NEIGHBOURS, -1 for none
+	IndexHeap open;
+
+	bool IsPassable(int index, glm::ivec2 pos) const;
+};
@@ -0,0 +1,90 @@
+// internal
+#include "force_field.hpp"
+#include "tiny_ecs_registry.hpp"
+
+using namespace std;
+
+void ForceField::Reset(int rows, int cols, float tileSize)
+{
+	this->rows = rows;
+	this->cols = cols;
+	this->tileSize = tileSize;
+	flow.assign(rows * cols, vec2(0));
+	footprints.clear();
+}
+
+void ForceField::AddWind(Entity windEntity, const Wind &wind)
+{
+	assert(FindFootprint(windEntity) < 0 && "wind already rasterised");
+
+	Footprint footprint;
+	footprint.windEntity = windEntity;
+	footprint.flow = wind.GetFlowVelocity();
+
+	// only visit the tiles around the wind, the exact shape is decided by InRange()
+	// entities are placed at (col * tileSize, row * tileSize), so test these points
+	float extent = glm::max(wind.length, wind.width);
+	int rowBegin = glm::max(0, (int)floor((wind.pos.y - extent) / tileSize));
+	int rowEnd = glm::min(rows - 1, (int)ceil((wind.pos.y + extent) / tileSize));
+	int colBegin = glm::max(0, (int)floor((wind.pos.x - extent) / tileSize));
+	int colEnd = glm::min(cols - 1, (int)ceil((wind.pos.x + extent) / tileSize));
+
+	for (int row = rowBegin; row <= rowEnd; ++row)
+	{
+		for (int col = colBegin; col <= colEnd; ++col)
+		{
+			if (wind.InRange(vec2(col * tileSize, row * tileSize)) == false)
+				continue;
+
+			int index = row * cols + col;
+			flow[index] += footprint.flow;
+			footprint.tiles.push_back(index);
+		}
+	}
+
+	footprints.push_back(std::move(footprint));
+}
+
+void ForceField::RemoveWind(Entity windEntity)
+{
+	int i = FindFootprint(windEntity);
+	if (i < 0)
+		return;
+
+	Footprint &footprint = footprints[i];
+	for (int index : footprint.tiles)
+	{
+		flow[index] -= footprint.flow;
+	}
+
+	// swap with the last one, the order of footprints doesn't matter
+	footprints[i] = std::move(footprints.back());
+	footprints.pop_back();
+}
+
+void ForceField::Build(int rows, int cols, float tileSize)
+{
+	Reset(rows, cols, tileSize);
+	for (uint i = 0; i < registry.winds.size(); ++i)
+		AddWind(registry.winds.entities[i], registry.winds.components[i]);
+}
+
+vec2 ForceField::Sample(vec2 position) const
+{
+	int row = (int)floor(position.y / tileSize + 0.5f);
+	int col = (int)floor(position.x / tileSize + 0.5f);
+	if (row < 0 || row >= rows || col < 0 || col >= cols)
+		return vec2(0);
+	return flow[row * cols + col];
+}
+
+int ForceField::FindFootprint(Entity windEntity) const
+{
+	for (int i = 0; i < (int)footprints.size(); ++i)
+	{
+		Entity e = footprints[i].windEntity;
+		if ((unsigned int)e == (unsigned int)windEntity)
+			return i;
+	}
+	return -1;
+}
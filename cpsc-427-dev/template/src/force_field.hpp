@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+#include "tiny_ecs.hpp"
+
+/*
+* a per-tile grid of flow velocities built from the wind zones of a level
+*
+* every wind is rasterised once into the tiles it covers and overlapping winds are summed,
+* so any dynamic body can sample the combined flow at its position in O(1).
+* the field is built once when a level is loaded, adding or removing a wind later only touches
+* the tiles covered by that wind.
+*/
+class ForceField
+{
+public:
+	ForceField() :rows(0), cols(0), tileSize(1.0f) {}
+
+	// drop all the winds and cover a map of rows x cols tiles, each tile is tileSize pixels
+	void Reset(int rows, int cols, float tileSize);
+
+	// rasterise a wind into the tiles it covers
+	void AddWind(Entity windEntity, const Wind &wind);
+
+	// subtract a wind from the tiles it covers
+	void RemoveWind(Entity windEntity);
+
+	// Reset() then add every wind of the registry
+	void Build(int rows, int cols, float tileSize);
+
+	// returns the combined flow velocity at a pixel position, zero outside of the map
+	vec2 Sample(vec2 position) const;
+
+	int GetRows() const { return rows; }
+	int GetCols() const { return cols; }
+
+private:
+	// the tiles a wind was rasterised into, used to remove it again
+	struct Footprint
+	{
+		Entity windEntity;
+		vec2 flow;
+		std::vector<int> tiles;
+	};
+
+	int rows;
+	int cols;
+	float tileSize;
+	std::vector<vec2> flow; // row-major, rows * cols
+	std::vector<Footprint> footprints;
+
+	int FindFootprint(Entity windEntity) const;
+};
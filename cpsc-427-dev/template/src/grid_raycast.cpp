@@ -0,0 +1,90 @@
+// internal
+#include "grid_raycast.hpp"
+
+#include <cfloat>
+#include <cmath>
+
+using glm::ivec2;
+using glm::vec2;
+
+// two borders closer than this (in ray parameter) are the same corner, the rounding of tMax must
+// not let a ray through a corner skip the tile on one of its sides
+const float CORNER_EPSILON = 1e-5f;
+
+// the DDA walk, Open(tile) tells if the ray can cross a tile
+template <typename F>
+static bool WalkRay(vec2 from, vec2 to, F Open)
+{
+	ivec2 tile(floor(from.x), floor(from.y));
+	ivec2 end(floor(to.x), floor(to.y));
+	if (!Open(tile))
+		return false;
+
+	vec2 dir = to - from;
+	ivec2 step(dir.x > 0 ? 1 : -1, dir.y > 0 ? 1 : -1);
+
+	// the ray parameter t (0 at from, 1 at to) of the next vertical / horizontal tile border, and
+	// how much t grows from one border to the next
+	vec2 tMax(FLT_MAX), tDelta(FLT_MAX);
+	if (dir.x != 0)
+	{
+		tDelta.x = 1.0f / fabs(dir.x);
+		tMax.x = (dir.x > 0 ? tile.x + 1 - from.x : from.x - tile.x) * tDelta.x;
+	}
+	if (dir.y != 0)
+	{
+		tDelta.y = 1.0f / fabs(dir.y);
+		tMax.y = (dir.y > 0 ? tile.y + 1 - from.y : from.y - tile.y) * tDelta.y;
+	}
+
+	// the end tile is reached after this many borders, it bounds the walk against rounding errors
+	int borders = abs(end.x - tile.x) + abs(end.y - tile.y);
+	while (borders > 0)
+	{
+		if (tMax.x < tMax.y - CORNER_EPSILON)
+		{
+			tile.x += step.x;
+			tMax.x += tDelta.x;
+			borders--;
+		}
+		else if (tMax.y < tMax.x - CORNER_EPSILON)
+		{
+			tile.y += step.y;
+			tMax.y += tDelta.y;
+			borders--;
+		}
+		else
+		{
+			// through a corner, both tiles on the sides have to be open
+			if (!Open(ivec2(tile.x + step.x, tile.y)) || !Open(ivec2(tile.x, tile.y + step.y)))
+				return false;
+			tile += step;
+			tMax += tDelta;
+			borders -= 2;
+		}
+
+		if (!Open(tile))
+			return false;
+	}
+	return true;
+}
+
+bool grid_line_of_sight(const NavGrid &grid, vec2 from, vec2 to, int minClearance)
+{
+	return WalkRay(from, to, [&](ivec2 tile) { return grid.IsValid(tile) && grid.GetClearance(grid.ToIndex(tile)) >= minClearance; });
+}
+
+bool grid_line_of_sight(const NavGrid &grid, ivec2 from, ivec2 to, int clearance, ivec2 relaxA, ivec2 relaxB)
+{
+	return WalkRay(vec2(from) + 0.5f, vec2(to) + 0.5f, [&](ivec2 tile)
+		{
+			if (!grid.IsValid(tile))
+				return false;
+			int index = grid.ToIndex(tile);
+			if (grid.GetClearance(index) >= clearance)
+				return true;
+			if (!grid.IsWalkable(index))
+				return false;
+			return NavGrid::Chebyshev(tile, relaxA) < clearance || NavGrid::Chebyshev(tile, relaxB) < clearance;
+		});
+}
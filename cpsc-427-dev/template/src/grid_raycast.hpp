@@ -0,0 +1,26 @@
+#pragma once
+
+#include "nav_grid.hpp"
+
+/*
+* raycasts on the navigation grid, Amanatides & Woo's DDA: the ray steps from tile to tile
+* through every tile it crosses, in the order it crosses them, without any sampling.
+*
+* positions are in tile units where tile (x, y) covers [x, x + 1) x [y, y + 1), so the center
+* of tile (x, y) is (x + 0.5, y + 0.5). a ray through the exact corner of 4 tiles needs both
+* tiles on its sides, like a diagonal move of the path searches.
+*/
+
+// true if every tile crossed by the segment from -> to has at least minClearance
+// (1: not a wall). tiles outside of the grid block the ray
+bool grid_line_of_sight(const NavGrid &grid, glm::vec2 from, glm::vec2 to, int minClearance = 1);
+
+// the same from the center of one tile to the center of another one
+inline bool grid_line_of_sight(const NavGrid &grid, glm::ivec2 from, glm::ivec2 to, int minClearance = 1)
+{
+	return grid_line_of_sight(grid, glm::vec2(from) + 0.5f, glm::vec2(to) + 0.5f, minClearance);
+}
+
+// the same with the rule of the path searches near their start and goal: a tile closer than
+// clearance (chebyshev) to relaxA or relaxB only has to be walkable
+bool grid_line_of_sight(const NavGrid &grid, glm::ivec2 from, glm::ivec2 to, int clearance, glm::ivec2 relaxA, glm::ivec2 relaxB);
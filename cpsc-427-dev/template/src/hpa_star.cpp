@@ -0,0 +1,556 @@
+// internal
+#include "hpa_star.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+using glm::ivec2;
+
+// an opening between two clusters that is at least this long gets an entrance at both ends
+const int HPA_LONG_ENTRANCE = 6;
+
+// far from every tile, so nothing is relaxed
+const ivec2 HPA_NO_RELAX = ivec2(-1000000);
+
+inline float Octile(ivec2 a, ivec2 b)
+{
+	int dx = abs(a.x - b.x);
+	int dy = abs(a.y - b.y);
+	return (float)(dx + dy) + (NAV_STEP_COST[4] - 2.0f) * (float)std::min(dx, dy);
+}
+
+void HPAStar::Build(const NavGrid &grid, int clusterSize, int clearance)
+{
+	assert(clearance < clusterSize && "The query rect is 2 x 2 clusters at most");
+	this->grid = &grid;
+	this->clusterSize = clusterSize;
+	this->clearance = clearance;
+	clustersX = (grid.GetCols() + clusterSize - 1) / clusterSize;
+	clustersY = (grid.GetRows() + clusterSize - 1) / clusterSize;
+
+	nodes.clear();
+	edges.clear();
+	freeNodes.clear();
+	clusterNodes.assign(clustersX * clustersY, vector<int>());
+	nodeOfTile.assign(grid.GetSize(), -1);
+	queryEdgeOwners.clear();
+
+	relaxA = HPA_NO_RELAX;
+	relaxB = HPA_NO_RELAX;
+
+	// a query rect is at most 2 x 2 clusters
+	localCost.assign(4 * clusterSize * clusterSize, -1.0f);
+	localParent.assign(4 * clusterSize * clusterSize, -1);
+	localOpen.Init(4 * clusterSize * clusterSize);
+
+	// entrances on the right and bottom border of every cluster
+	for (int cluster = 0; cluster < clustersX * clustersY; ++cluster)
+	{
+		AddBorderEntrances(cluster, true);
+		AddBorderEntrances(cluster, false);
+	}
+
+	for (int cluster = 0; cluster < clustersX * clustersY; ++cluster)
+		LinkClusterNodes(cluster);
+
+	InitAbstractSearch();
+	expandedCount = 0;
+}
+
+void HPAStar::InitAbstractSearch()
+{
+	// the abstract search also holds the start and the goal of a query
+	int capacity = (int)nodes.size() + 2;
+	gScore.assign(capacity, 0);
+	parent.assign(capacity, -1);
+	stamp.assign(capacity, 0);
+	generation = 0;
+	open.Init(capacity);
+}
+
+void HPAStar::Repair(ivec2 changedBegin, ivec2 changedEnd)
+{
+	assert(grid != nullptr && "HPAStar::Build() not called");
+	relaxA = HPA_NO_RELAX;
+	relaxB = HPA_NO_RELAX;
+
+	// the clusters with changed tiles, and every cluster sharing a border with them
+	ivec2 dirtyBegin = changedBegin / clusterSize;
+	ivec2 dirtyEnd = (changedEnd - 1) / clusterSize + 1;
+	ivec2 touchedBegin = glm::max(dirtyBegin - 1, ivec2(0));
+	ivec2 touchedEnd = glm::min(dirtyEnd + 1, ivec2(clustersX, clustersY));
+
+	auto IsDirty = [&](int cluster)
+	{
+		ivec2 c(cluster % clustersX, cluster / clustersX);
+		return dirtyBegin.x <= c.x && c.x < dirtyEnd.x && dirtyBegin.y <= c.y && c.y < dirtyEnd.y;
+	};
+
+	// drop the inter edges across the borders of the dirty clusters, and all the intra edges of
+	// the touched clusters. nodes left without an inter edge are not entrances anymore
+	for (int cy = touchedBegin.y; cy < touchedEnd.y; ++cy)
+	{
+		for (int cx = touchedBegin.x; cx < touchedEnd.x; ++cx)
+		{
+			int cluster = cy * clustersX + cx;
+			for (int node : clusterNodes[cluster])
+			{
+				auto &list = edges[node];
+				list.erase(std::remove_if(list.begin(), list.end(), [&](const Edge &edge)
+					{
+						return !edge.inter || IsDirty(cluster) || IsDirty(nodes[edge.to].cluster);
+					}), list.end());
+			}
+		}
+	}
+	for (int cy = touchedBegin.y; cy < touchedEnd.y; ++cy)
+	{
+		for (int cx = touchedBegin.x; cx < touchedEnd.x; ++cx)
+		{
+			auto &list = clusterNodes[cy * clustersX + cx];
+			list.erase(std::remove_if(list.begin(), list.end(), [&](int node)
+				{
+					if (!edges[node].empty())
+						return false;
+					nodeOfTile[nodes[node].tile] = -1;
+					freeNodes.push_back(node);
+					return true;
+				}), list.end());
+		}
+	}
+
+	// entrances on the borders of the dirty clusters, the left and top borders are the
+	// right and bottom borders of the neighbours
+	for (int cy = dirtyBegin.y; cy < dirtyEnd.y; ++cy)
+	{
+		for (int cx = dirtyBegin.x; cx < dirtyEnd.x; ++cx)
+		{
+			int cluster = cy * clustersX + cx;
+			AddBorderEntrances(cluster, true);
+			AddBorderEntrances(cluster, false);
+			if (cx > 0 && !IsDirty(cluster - 1))
+				AddBorderEntrances(cluster - 1, true);
+			if (cy > 0 && !IsDirty(cluster - clustersX))
+				AddBorderEntrances(cluster - clustersX, false);
+		}
+	}
+
+	for (int cy = touchedBegin.y; cy < touchedEnd.y; ++cy)
+		for (int cx = touchedBegin.x; cx < touchedEnd.x; ++cx)
+			LinkClusterNodes(cy * clustersX + cx);
+
+	InitAbstractSearch();
+}
+
+int HPAStar::GetEdgeCount() const
+{
+	int count = 0;
+	for (auto &list : edges)
+		count += (int)list.size();
+	return count;
+}
+
+void HPAStar::GetClusterRect(int cluster, ivec2 &begin, ivec2 &end) const
+{
+	begin = ivec2(cluster % clustersX, cluster / clustersX) * clusterSize;
+	end = glm::min(begin + clusterSize, ivec2(grid->GetCols(), grid->GetRows()));
+}
+
+bool HPAStar::IsPassable(ivec2 pos) const
+{
+	int index = grid->ToIndex(pos);
+	if (grid->GetClearance(index) >= clearance)
+		return true;
+	if (!grid->IsWalkable(index))
+		return false;
+	return NavGrid::Chebyshev(pos, relaxA) < clearance || NavGrid::Chebyshev(pos, relaxB) < clearance;
+}
+
+int HPAStar::AddNode(ivec2 pos)
+{
+	int tile = grid->ToIndex(pos);
+	if (nodeOfTile[tile] >= 0)
+		return nodeOfTile[tile];
+
+	int node;
+	if (!freeNodes.empty())
+	{
+		node = freeNodes.back();
+		freeNodes.pop_back();
+		nodes[node] = { tile, GetCluster(pos) };
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.push_back({ tile, GetCluster(pos) });
+		edges.emplace_back();
+	}
+	clusterNodes[nodes[node].cluster].push_back(node);
+	nodeOfTile[tile] = node;
+	return node;
+}
+
+void HPAStar::AddEdge(int from, int to, float cost, bool inter)
+{
+	edges[from].push_back({ to, cost, inter });
+}
+
+void HPAStar::AddEntrances(ivec2 sideA, ivec2 step, ivec2 across, int length)
+{
+	auto AddEntrance = [&](int i)
+	{
+		ivec2 a = sideA + step * i;
+		int nodeA = AddNode(a);
+		int nodeB = AddNode(a + across);
+		AddEdge(nodeA, nodeB, 1.0f, true);
+		AddEdge(nodeB, nodeA, 1.0f, true);
+	};
+
+	// every run of open tile pairs across the border is an opening
+	int runBegin = -1;
+	for (int i = 0; i <= length; ++i)
+	{
+		bool isOpen = i < length && IsPassable(sideA + step * i) && IsPassable(sideA + step * i + across);
+		if (isOpen && runBegin < 0)
+			runBegin = i;
+		if (isOpen || runBegin < 0)
+			continue;
+
+		int runEnd = i - 1;
+		if (runEnd - runBegin + 1 >= HPA_LONG_ENTRANCE)
+		{
+			AddEntrance(runBegin);
+			AddEntrance(runEnd);
+		}
+		else
+		{
+			AddEntrance((runBegin + runEnd) / 2);
+		}
+		runBegin = -1;
+	}
+}
+
+void HPAStar::AddBorderEntrances(int cluster, bool right)
+{
+	ivec2 begin, end;
+	GetClusterRect(cluster, begin, end);
+
+	if (right && end.x < grid->GetCols())
+		AddEntrances(ivec2(end.x - 1, begin.y), ivec2(0, 1), ivec2(1, 0), end.y - begin.y);
+	if (!right && end.y < grid->GetRows())
+		AddEntrances(ivec2(begin.x, end.y - 1), ivec2(1, 0), ivec2(0, 1), end.x - begin.x);
+}
+
+void HPAStar::LinkClusterNodes(int cluster)
+{
+	const vector<int> &list = clusterNodes[cluster];
+	for (int from : list)
+	{
+		SearchCluster(grid->ToPos(nodes[from].tile));
+		for (int to : list)
+		{
+			if (to == from)
+				continue;
+			float cost = GetLocalCost(grid->ToPos(nodes[to].tile));
+			if (cost >= 0)
+				AddEdge(from, to, cost, false);
+		}
+	}
+}
+
+void HPAStar::GetQueryRect(ivec2 pos, ivec2 &begin, ivec2 &end) const
+{
+	const ivec2 gridEnd(grid->GetCols(), grid->GetRows());
+	// one tile past the relaxed ones: a relaxed tile on a border is not an entrance, the cluster
+	// on the other side is searched too
+	const ivec2 first = glm::max(pos - clearance, ivec2(0)) / clusterSize;
+	const ivec2 last = glm::min(pos + clearance, gridEnd - 1) / clusterSize;
+	begin = first * clusterSize;
+	end = glm::min((last + 1) * clusterSize, gridEnd);
+}
+
+void HPAStar::SearchCluster(ivec2 source)
+{
+	ivec2 begin, end;
+	GetClusterRect(GetCluster(source), begin, end);
+	SearchRect(source, begin, end);
+}
+
+void HPAStar::SearchRect(ivec2 source, ivec2 begin, ivec2 end)
+{
+	localBegin = begin;
+	localEnd = end;
+	int width = localEnd.x - localBegin.x;
+
+	std::fill(localCost.begin(), localCost.end(), -1.0f);
+	localOpen.Clear();
+
+	auto LocalIndex = [&](ivec2 pos) { return (pos.y - localBegin.y) * width + (pos.x - localBegin.x); };
+	auto InCluster = [&](ivec2 pos) { return localBegin.x <= pos.x && pos.x < localEnd.x && localBegin.y <= pos.y && pos.y < localEnd.y; };
+
+	int sourceIndex = LocalIndex(source);
+	localCost[sourceIndex] = 0;
+	localParent[sourceIndex] = -1;
+	localOpen.Push(sourceIndex, 0);
+
+	while (!localOpen.Empty())
+	{
+		int cur = localOpen.Pop();
+		expandedCount++;
+
+		ivec2 curPos = localBegin + ivec2(cur % width, cur / width);
+		bool passable[8];
+		for (int d = 0; d < 8; ++d)
+		{
+			ivec2 newPos = curPos + NAV_NEIGHBOURS[d];
+			passable[d] = InCluster(newPos) && IsPassable(newPos);
+			if (d >= 4)
+				passable[d] = passable[d] && passable[NAV_DIAGONAL_SIDES[d][0]] && passable[NAV_DIAGONAL_SIDES[d][1]];
+			if (!passable[d])
+				continue;
+
+			int next = LocalIndex(newPos);
+			float c = localCost[cur] + NAV_STEP_COST[d];
+			bool reached = localCost[next] >= 0;
+			if (reached && (!localOpen.Contains(next) || c >= localCost[next]))
+				continue;
+
+			localCost[next] = c;
+			localParent[next] = cur;
+			if (reached)
+				localOpen.Decrease(next, c);
+			else
+				localOpen.Push(next, c);
+		}
+	}
+}
+
+float HPAStar::GetLocalCost(ivec2 pos) const
+{
+	if (pos.x < localBegin.x || pos.x >= localEnd.x || pos.y < localBegin.y || pos.y >= localEnd.y)
+		return -1.0f;
+	int width = localEnd.x - localBegin.x;
+	return localCost[(pos.y - localBegin.y) * width + (pos.x - localBegin.x)];
+}
+
+int HPAStar::InsertQueryNode(ivec2 pos, bool isGoal)
+{
+	int tile = grid->ToIndex(pos);
+	int node = nodeOfTile[tile];
+	if (node < 0)
+	{
+		// a temporary node, not listed in its cluster
+		node = (int)nodes.size();
+		nodes.push_back({ tile, GetCluster(pos) });
+		edges.emplace_back();
+	}
+
+	// moves are symmetric, so one search from the query tile gives the costs in both directions.
+	// a node of the graph gets the edges too, its own ones don't use the relaxed tiles. all of them
+	// are removed after the query
+	ivec2 begin, end;
+	GetQueryRect(pos, begin, end);
+	SearchRect(pos, begin, end);
+	for (int cy = begin.y / clusterSize; cy * clusterSize < end.y; ++cy)
+	{
+		for (int cx = begin.x / clusterSize; cx * clusterSize < end.x; ++cx)
+		{
+			for (int other : clusterNodes[cy * clustersX + cx])
+			{
+				float cost = GetLocalCost(grid->ToPos(nodes[other].tile));
+				if (cost < 0 || other == node)
+					continue;
+
+				if (isGoal)
+				{
+					AddEdge(other, node, cost, false);
+					queryEdgeOwners.push_back(other);
+				}
+				else
+				{
+					AddEdge(node, other, cost, false);
+					queryEdgeOwners.push_back(node);
+				}
+			}
+		}
+	}
+	return node;
+}
+
+void HPAStar::RemoveQueryNodes(int firstQueryNode)
+{
+	// the query edges were appended last to their owners
+	for (int i = (int)queryEdgeOwners.size() - 1; i >= 0; --i)
+		edges[queryEdgeOwners[i]].pop_back();
+	queryEdgeOwners.clear();
+
+	nodes.resize(firstQueryNode);
+	edges.resize(firstQueryNode);
+}
+
+bool HPAStar::FindAbstractPath(ivec2 start, ivec2 goal, vector<ivec2> &outNodes)
+{
+	assert(grid != nullptr && "HPAStar::Build() not called");
+
+	outNodes.clear();
+	expandedCount = 0;
+
+	start = grid->Clamp(start);
+	goal = grid->Clamp(goal);
+	relaxA = start;
+	relaxB = goal;
+
+	if (start == goal)
+	{
+		outNodes.push_back(start);
+		return true;
+	}
+
+	int firstQueryNode = (int)nodes.size();
+	int goalNode = InsertQueryNode(goal, true);
+	float direct = GetLocalCost(start);
+	int startNode = InsertQueryNode(start, false);
+
+	// the start reaches the goal in one of their query rects, without the graph. the search picks
+	// the shorter way
+	float fromStart = GetLocalCost(goal);
+	if (fromStart >= 0 && (direct < 0 || fromStart < direct))
+		direct = fromStart;
+	if (direct >= 0)
+	{
+		AddEdge(startNode, goalNode, direct, false);
+		queryEdgeOwners.push_back(startNode);
+	}
+
+	// A* on the abstract graph
+	if (++generation == 0)
+	{
+		std::fill(stamp.begin(), stamp.end(), 0);
+		generation = 1;
+	}
+	open.Clear();
+
+	stamp[startNode] = generation;
+	gScore[startNode] = 0;
+	parent[startNode] = -1;
+	open.Push(startNode, Octile(start, goal));
+
+	bool found = false;
+	while (!open.Empty())
+	{
+		int cur = open.Pop();
+		expandedCount++;
+
+		if (cur == goalNode)
+		{
+			found = true;
+			break;
+		}
+
+		for (const Edge &edge : edges[cur])
+		{
+			float g = gScore[cur] + edge.cost;
+			float f = g + Octile(grid->ToPos(nodes[edge.to].tile), goal);
+			if (stamp[edge.to] != generation)
+			{
+				stamp[edge.to] = generation;
+				gScore[edge.to] = g;
+				parent[edge.to] = cur;
+				open.Push(edge.to, f);
+			}
+			else if (open.Contains(edge.to) && g < gScore[edge.to])
+			{
+				gScore[edge.to] = g;
+				parent[edge.to] = cur;
+				open.Decrease(edge.to, f);
+			}
+		}
+	}
+
+	if (found)
+	{
+		for (int i = goalNode; i >= 0; i = parent[i])
+			outNodes.push_back(grid->ToPos(nodes[i].tile));
+		std::reverse(outNodes.begin(), outNodes.end());
+	}
+
+	RemoveQueryNodes(firstQueryNode);
+	return found;
+}
+
+bool HPAStar::RefineSegment(ivec2 from, ivec2 to, vector<ivec2> &outTiles)
+{
+	outTiles.clear();
+
+	// an edge of the start or the goal of the query, found in the query rect of one of them (the
+	// shorter way if both)
+	int bestRect = -1;
+	float bestCost = -1.0f;
+	ivec2 begin[2], end[2];
+	const ivec2 query[2] = { relaxA, relaxB };
+	for (int i = 0; i < 2; ++i)
+	{
+		GetQueryRect(query[i], begin[i], end[i]);
+		auto Inside = [&](ivec2 pos) { return begin[i].x <= pos.x && pos.x < end[i].x && begin[i].y <= pos.y && pos.y < end[i].y; };
+		if ((from != query[i] && to != query[i]) || !Inside(from) || !Inside(to))
+			continue;
+
+		SearchRect(from, begin[i], end[i]);
+		float cost = GetLocalCost(to);
+		if (cost >= 0 && (bestCost < 0 || cost < bestCost))
+		{
+			bestRect = i;
+			bestCost = cost;
+		}
+	}
+
+	if (bestRect >= 0)
+	{
+		// the last search may have been in the other rect
+		SearchRect(from, begin[bestRect], end[bestRect]);
+	}
+	// an inter edge, the two tiles are next to each other across a border
+	else if (GetCluster(from) != GetCluster(to))
+	{
+		if (NavGrid::Chebyshev(from, to) > 1)
+			return false;
+		outTiles.push_back(from);
+		outTiles.push_back(to);
+		return true;
+	}
+	else
+	{
+		SearchCluster(from);
+	}
+
+	if (GetLocalCost(to) < 0)
+		return false;
+
+	int width = localEnd.x - localBegin.x;
+	for (int i = (to.y - localBegin.y) * width + (to.x - localBegin.x); i >= 0; i = localParent[i])
+		outTiles.push_back(localBegin + ivec2(i % width, i / width));
+	std::reverse(outTiles.begin(), outTiles.end());
+	return true;
+}
+
+bool HPAStar::FindPath(ivec2 start, ivec2 goal, vector<ivec2> &outPath)
+{
+	outPath.clear();
+
+	vector<ivec2> abstractPath;
+	if (!FindAbstractPath(start, goal, abstractPath))
+		return false;
+
+	// the expansions of the refinement are counted too
+	vector<ivec2> segment;
+	outPath.push_back(abstractPath[0]);
+	for (size_t i = 1; i < abstractPath.size(); ++i)
+	{
+		if (!RefineSegment(abstractPath[i - 1], abstractPath[i], segment))
+			return false;
+		outPath.insert(outPath.end(), segment.begin() + 1, segment.end());
+	}
+
+	return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "index_heap.hpp"
+
+/*
+* hierarchical pathfinding (HPA*) for big levels
+*
+* the grid is split in square clusters. Build() finds the entrances on the borders between two
+* clusters (one in the middle of a short opening, one at both ends of a long one) and links them:
+*   inter edges - an entrance and its twin on the other side of the border, cost 1
+*   intra edges - two entrances of the same cluster, cost of the shortest path inside the cluster
+* a query only searches this abstract graph, the start and the goal are linked to the entrances of
+* their query rect first, and to each other if one reaches the other there. the abstract path is then
+* refined one segment at a time, every segment stays inside one cluster (or the query rect of the
+* start or the goal), so the caller only pays for the next cluster it walks through.
+*
+* the passability is the same as PathSearch: clearance >= the clearance of the graph, relaxed to
+* walkable near the start and the goal of the query. the entrances are built without the relaxation,
+* so the query rect of a start or a goal covers every cluster its relaxed tiles are in.
+*
+* the paths are not always the shortest: they go through the entrances. on the benchmark maps they
+* are a few percent longer than the flat A* paths on average, pathfinding_bench reports the ratio.
+*/
+class HPAStar
+{
+public:
+	HPAStar() :grid(nullptr), clusterSize(0), clearance(0), clustersX(0), clustersY(0), expandedCount(0) {}
+
+	// split the grid in clusters of clusterSize x clusterSize tiles and build the abstract graph
+	void Build(const NavGrid &grid, int clusterSize, int clearance);
+
+	bool IsBuilt() const { return grid != nullptr; }
+
+	// tiles in [changedBegin, changedEnd) changed their passability, rebuild the entrances on the
+	// borders of the clusters they are in, and the intra edges of the clusters on these borders
+	void Repair(glm::ivec2 changedBegin, glm::ivec2 changedEnd);
+
+	// search the abstract graph, outNodes gets the tiles of the abstract path from start to goal (both included).
+	// return false if the goal can't be reached
+	bool FindAbstractPath(glm::ivec2 start, glm::ivec2 goal, std::vector<glm::ivec2> &outNodes);
+
+	// the tiles from one node of the last abstract path to the next one (both included)
+	bool RefineSegment(glm::ivec2 from, glm::ivec2 to, std::vector<glm::ivec2> &outTiles);
+
+	// abstract path refined completely, for comparisons with a flat search
+	bool FindPath(glm::ivec2 start, glm::ivec2 goal, std::vector<glm::ivec2> &outPath);
+
+	int GetNodeCount() const { return (int)(nodes.size() - freeNodes.size()); }
+	int GetEdgeCount() const;
+
+	// tiles and abstract nodes expanded by the last query (FindAbstractPath or FindPath)
+	int GetExpandedCount() const { return expandedCount; }
+
+private:
+	struct Edge
+	{
+		int to;
+		float cost;
+		bool inter; // across a cluster border
+	};
+
+	struct Node
+	{
+		int tile;
+		int cluster;
+	};
+
+	const NavGrid *grid;
+	int clusterSize;
+	int clearance;
+	int clustersX;
+	int clustersY;
+
+	// nodes removed by Repair() leave their slot, without edges, to the next new node. the ids of
+	// the other nodes don't change
+	std::vector<Node> nodes;
+	std::vector<std::vector<Edge>> edges;
+	std::vector<int> freeNodes;
+	std::vector<std::vector<int>> clusterNodes; // the nodes in every cluster
+	std::vector<int> nodeOfTile; // -1 if the tile is not a node
+
+	// tiles near these ones only have to be walkable, set by the query
+	glm::ivec2 relaxA;
+	glm::ivec2 relaxB;
+
+	// dijkstra inside one cluster, indexed by the tile position in the cluster
+	glm::ivec2 localBegin;
+	glm::ivec2 localEnd;
+	std::vector<float> localCost; // < 0 if not reached
+	std::vector<int> localParent;
+	IndexHeap localOpen;
+
+	// nodes that got an edge for the query, in order
+	std::vector<int> queryEdgeOwners;
+
+	// A* on the abstract graph
+	std::vector<float> gScore;
+	std::vector<int> parent;
+	std::vector<uint32_t> stamp;
+	uint32_t generation;
+	IndexHeap open;
+
+	int expandedCount;
+
+	int GetCluster(glm::ivec2 pos) const { return (pos.y / clusterSize) * clustersX + pos.x / clusterSize; }
+	void GetClusterRect(int cluster, glm::ivec2 &begin, glm::ivec2 &end) const;
+
+	bool IsPassable(glm::ivec2 pos) const;
+
+	int AddNode(glm::ivec2 pos);
+	void AddEdge(int from, int to, float cost, bool inter);
+	void AddEntrances(glm::ivec2 sideA, glm::ivec2 step, glm::ivec2 across, int length);
+	void AddBorderEntrances(int cluster, bool right);
+	void LinkClusterNodes(int cluster);
+
+	// size the abstract search buffers for the nodes
+	void InitAbstractSearch();
+
+	// the clusters around a query tile that its relaxed tiles are in
+	void GetQueryRect(glm::ivec2 pos, glm::ivec2 &begin, glm::ivec2 &end) const;
+
+	// dijkstra from source over the tiles of its cluster, or of [begin, end)
+	void SearchCluster(glm::ivec2 source);
+	void SearchRect(glm::ivec2 source, glm::ivec2 begin, glm::ivec2 end);
+	float GetLocalCost(glm::ivec2 pos) const;
+
+	// link a query tile to the nodes of its query rect, return its node. the search from the tile
+	// is left in the local arrays
+	int InsertQueryNode(glm::ivec2 pos, bool isGoal);
+	void RemoveQueryNodes(int firstQueryNode);
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+// stlib
+#include <cassert>
+#include <utility>
+#include <vector>
+
+/*
+* binary min heap of tile indices, each tile is in the heap at most once and its key can be decreased
+*
+* the memory is allocated by Init() for the number of tiles, Push/Pop/Decrease/Clear don't allocate.
+* used by the grid searches (A*, dijkstra), where the key is the f or g score of a tile.
+*/
+class IndexHeap
+{
+public:
+	// allocate for tiles 0..size-1
+	void Init(int size)
+	{
+		entries.clear();
+		entries.reserve(size);
+		position.assign(size, -1);
+	}
+
+	// remove all the tiles, only touches the tiles that are still in the heap
+	void Clear()
+	{
+		for (auto &entry : entries)
+			position[entry.tile] = -1;
+		entries.clear();
+	}
+
+	bool Empty() const { return entries.empty(); }
+	int Size() const { return (int)entries.size(); }
+	bool Contains(int tile) const { return position[tile] >= 0; }
+
+	// key of the top tile, the heap must not be empty
+	float TopKey() const { return entries[0].key; }
+
+	void Push(int tile, float key)
+	{
+		assert(!Contains(tile) && "tile already in heap");
+		entries.push_back({ key, tile });
+		position[tile] = (int)entries.size() - 1;
+		Up((int)entries.size() - 1);
+	}
+
+	// remove and return the tile with the smallest key
+	int Pop()
+	{
+		int top = entries[0].tile;
+		Swap(0, (int)entries.size() - 1);
+		entries.pop_back();
+		position[top] = -1;
+		if (!entries.empty())
+			Down(0);
+		return top;
+	}
+
+	// lower the key of a tile that is in the heap
+	void Decrease(int tile, float key)
+	{
+		int i = position[tile];
+		assert(i >= 0 && key <= entries[i].key);
+		entries[i].key = key;
+		Up(i);
+	}
+
+private:
+	struct Entry
+	{
+		float key;
+		int tile;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<int> position; // index of a tile in entries, -1 when not in the heap
+
+	void Up(int i)
+	{
+		while (i > 0)
+		{
+			int p = (i - 1) / 2;
+			if (entries[p].key <= entries[i].key)
+				break;
+			Swap(i, p);
+			i = p;
+		}
+	}
+
+	void Down(int i)
+	{
+		int n = (int)entries.size();
+		while (true)
+		{
+			int l = 2 * i + 1;
+			int r = l + 1;
+			int smallest = i;
+			if (l < n && entries[l].key < entries[smallest].key)
+				smallest = l;
+			if (r < n && entries[r].key < entries[smallest].key)
+				smallest = r;
+			if (smallest == i)
+				break;
+			Swap(i, smallest);
+			i = smallest;
+		}
+	}
+
+	void Swap(int i, int j)
+	{
+		std::swap(entries[i], entries[j]);
+		position[entries[i].tile] = i;
+		position[entries[j].tile] = j;
+	}
+};
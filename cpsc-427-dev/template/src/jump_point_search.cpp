@@ -0,0 +1,386 @@
+// internal
+#include "jump_point_search.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+using namespace std;
+using glm::ivec2;
+
+void JumpPointSearch::Init(const NavGrid &grid, int clearance)
+{
+	this->grid = &grid;
+	this->clearance = clearance;
+
+	rowBits.Resize(grid.GetRows(), grid.GetCols());
+	colBits.Resize(grid.GetCols(), grid.GetRows());
+	for (int i = 0; i < grid.GetSize(); ++i)
+	{
+		if (grid.GetClearance(i) >= clearance)
+			SetPassable(grid.ToPos(i), true);
+	}
+
+	int size = grid.GetSize();
+	stamp.assign(size, 0);
+	gScore.assign(size, 0);
+	parent.assign(size, -1);
+	open.Init(size);
+
+	// two squares of (2 * clearance - 1) tiles
+	relaxed.clear();
+	relaxed.reserve(2 * (2 * clearance - 1) * (2 * clearance - 1));
+
+	status = Status::IDLE;
+	generation = 0;
+	expandedCount = 0;
+}
+
+void JumpPointSearch::SetPassable(ivec2 pos, bool value)
+{
+	rowBits.Set(pos.x, pos.y, value);
+	colBits.Set(pos.y, pos.x, value);
+}
+
+void JumpPointSearch::UpdateBits(ivec2 pos)
+{
+	SetPassable(pos, grid->GetClearance(grid->ToIndex(pos)) >= clearance);
+}
+
+void JumpPointSearch::Repair(ivec2 changedBegin, ivec2 changedEnd)
+{
+	// the relaxed tiles are set again on top of the new bits
+	bool running = status == Status::RUNNING;
+	ClearRelax();
+
+	for (int y = changedBegin.y; y < changedEnd.y; ++y)
+		for (int x = changedBegin.x; x < changedEnd.x; ++x)
+			UpdateBits(ivec2(x, y));
+
+	if (running)
+		ApplyRelax();
+}
+
+void JumpPointSearch::ApplyRelax()
+{
+	const ivec2 centers[2] = { start, goal };
+	for (ivec2 center : centers)
+	{
+		ivec2 begin = glm::max(center - (clearance - 1), ivec2(0));
+		ivec2 end = glm::min(center + clearance, ivec2(grid->GetCols(), grid->GetRows()));
+		for (int y = begin.y; y < end.y; ++y)
+		{
+			for (int x = begin.x; x < end.x; ++x)
+			{
+				ivec2 pos(x, y);
+				if (IsPassable(pos) || !grid->IsWalkable(grid->ToIndex(pos)))
+					continue;
+				SetPassable(pos, true);
+				relaxed.push_back(pos);
+			}
+		}
+	}
+}
+
+void JumpPointSearch::ClearRelax()
+{
+	for (ivec2 pos : relaxed)
+		UpdateBits(pos);
+	relaxed.clear();
+}
+
+int JumpPointSearch::ScanLine(const BitGrid &bits, int line, int pos, int dir)
+{
+	if (pos < 0 || pos >= bits.GetCols())
+		return pos;
+
+	// stop at a blocked tile, or where a side line is open but was blocked on the previous tile
+	const uint64_t *cur = bits.GetRow(line);
+	const uint64_t *side[2] = { bits.GetRow(line - 1), bits.GetRow(line + 1) };
+	int words = bits.GetWordsPerRow();
+
+	if (dir > 0)
+	{
+		for (int w = pos >> 6; w < words; ++w)
+		{
+			uint64_t stop = ~cur[w];
+			for (const uint64_t *s : side)
+			{
+				if (s == nullptr)
+					continue;
+				uint64_t previous = (s[w] << 1) | (w > 0 ? s[w - 1] >> 63 : 0);
+				stop |= s[w] & ~previous;
+			}
+			if (w == pos >> 6)
+				stop &= ~(uint64_t)0 << (pos & 63);
+			if (stop)
+				return (w << 6) + bit_lowest(stop);
+		}
+		return words << 6;
+	}
+	else
+	{
+		for (int w = pos >> 6; w >= 0; --w)
+		{
+			uint64_t stop = ~cur[w];
+			for (const uint64_t *s : side)
+			{
+				if (s == nullptr)
+					continue;
+				uint64_t previous = (s[w] >> 1) | (w + 1 < words ? s[w + 1] << 63 : 0);
+				stop |= s[w] & ~previous;
+			}
+			if (w == pos >> 6 && (pos & 63) != 63)
+				stop &= ((uint64_t)1 << ((pos & 63) + 1)) - 1;
+			if (stop)
+				return (w << 6) + bit_highest(stop);
+		}
+		return -1;
+	}
+}
+
+bool JumpPointSearch::JumpStraight(ivec2 from, ivec2 dir, ivec2 &jumpPoint) const
+{
+	// horizontal runs are rows of rowBits, vertical runs are rows of colBits
+	bool horizontal = dir.x != 0;
+	int line = horizontal ? from.y : from.x;
+	int first = (horizontal ? from.x : from.y) + (horizontal ? dir.x : dir.y);
+	int step = horizontal ? dir.x : dir.y;
+	int goalLine = horizontal ? goal.y : goal.x;
+	int goalPos = horizontal ? goal.x : goal.y;
+
+	int stop = ScanLine(horizontal ? rowBits : colBits, line, first, step);
+
+	auto ToTile = [&](int pos) { return horizontal ? ivec2(pos, line) : ivec2(line, pos); };
+
+	// the goal is before the stop
+	if (goalLine == line && (step > 0 ? (first <= goalPos && goalPos <= stop) : (stop <= goalPos && goalPos <= first)))
+	{
+		jumpPoint = goal;
+		return IsPassable(goal);
+	}
+
+	if (!IsPassable(ToTile(stop)))
+		return false;
+
+	jumpPoint = ToTile(stop);
+	return true;
+}
+
+bool JumpPointSearch::JumpDiagonal(ivec2 from, ivec2 dir, ivec2 &jumpPoint) const
+{
+	ivec2 pos = from;
+	while (true)
+	{
+		// no corner cutting
+		if (!IsPassable(ivec2(pos.x + dir.x, pos.y)) || !IsPassable(ivec2(pos.x, pos.y + dir.y)))
+			return false;
+
+		pos += dir;
+		if (!IsPassable(pos))
+			return false;
+
+		ivec2 unused;
+		if (pos == goal || JumpStraight(pos, ivec2(dir.x, 0), unused) || JumpStraight(pos, ivec2(0, dir.y), unused))
+		{
+			jumpPoint = pos;
+			return true;
+		}
+	}
+}
+
+void JumpPointSearch::Visit(int from, ivec2 jumpPoint)
+{
+	int next = grid->ToIndex(jumpPoint);
+	float g = gScore[from] + PathSearch::Heuristic(grid->ToPos(from), jumpPoint);
+
+	if (stamp[next] != generation)
+	{
+		stamp[next] = generation;
+		gScore[next] = g;
+		parent[next] = from;
+		open.Push(next, g + PathSearch::Heuristic(jumpPoint, goal));
+	}
+	else if (open.Contains(next) && g < gScore[next])
+	{
+		gScore[next] = g;
+		parent[next] = from;
+		open.Decrease(next, g + PathSearch::Heuristic(jumpPoint, goal));
+	}
+}
+
+void JumpPointSearch::Expand(int index)
+{
+	ivec2 pos = grid->ToPos(index);
+
+	// the directions to jump to, pruned by the direction we came from
+	ivec2 directions[8];
+	int count = 0;
+	auto Open = [&](int dx, int dy) { return IsPassable(pos + ivec2(dx, dy)); };
+
+	if (parent[index] < 0)
+	{
+		for (int d = 0; d < 8; ++d)
+			directions[count++] = NAV_NEIGHBOURS[d];
+	}
+	else
+	{
+		ivec2 dir = glm::sign(pos - grid->ToPos(parent[index]));
+		if (dir.x != 0 && dir.y != 0)
+		{
+			bool openX = Open(dir.x, 0);
+			bool openY = Open(0, dir.y);
+			if (openY)
+				directions[count++] = ivec2(0, dir.y);
+			if (openX)
+				directions[count++] = ivec2(dir.x, 0);
+			if (openX && openY)
+				directions[count++] = dir;
+		}
+		else if (dir.x != 0)
+		{
+			bool next = Open(dir.x, 0);
+			bool down = Open(0, 1);
+			bool up = Open(0, -1);
+			if (next)
+			{
+				directions[count++] = ivec2(dir.x, 0);
+				if (down)
+					directions[count++] = ivec2(dir.x, 1);
+				if (up)
+					directions[count++] = ivec2(dir.x, -1);
+			}
+			if (down)
+				directions[count++] = ivec2(0, 1);
+			if (up)
+				directions[count++] = ivec2(0, -1);
+		}
+		else
+		{
+			bool next = Open(0, dir.y);
+			bool right = Open(1, 0);
+			bool left = Open(-1, 0);
+			if (next)
+			{
+				directions[count++] = ivec2(0, dir.y);
+				if (right)
+					directions[count++] = ivec2(1, dir.y);
+				if (left)
+					directions[count++] = ivec2(-1, dir.y);
+			}
+			if (right)
+				directions[count++] = ivec2(1, 0);
+			if (left)
+				directions[count++] = ivec2(-1, 0);
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		ivec2 jumpPoint;
+		bool found = (directions[i].x != 0 && directions[i].y != 0) ?
+			JumpDiagonal(pos, directions[i], jumpPoint) : JumpStraight(pos, directions[i], jumpPoint);
+		if (found)
+			Visit(index, jumpPoint);
+	}
+}
+
+bool JumpPointSearch::FindPath(ivec2 start, ivec2 goal, vector<ivec2> &outPath)
+{
+	Begin(start, goal);
+	Step(INT_MAX);
+	GetPath(outPath);
+	return status == Status::FOUND;
+}
+
+void JumpPointSearch::Begin(ivec2 start, ivec2 goal)
+{
+	assert(grid != nullptr && (int)stamp.size() == grid->GetSize() && "JumpPointSearch::Init() not called");
+
+	ClearRelax();
+
+	this->start = grid->Clamp(start);
+	this->goal = grid->Clamp(goal);
+	status = Status::RUNNING;
+	expandedCount = 0;
+
+	ApplyRelax();
+
+	if (++generation == 0)
+	{
+		std::fill(stamp.begin(), stamp.end(), 0);
+		generation = 1;
+	}
+	open.Clear();
+
+	int startIndex = grid->ToIndex(this->start);
+	goalIndex = grid->ToIndex(this->goal);
+
+	stamp[startIndex] = generation;
+	gScore[startIndex] = 0;
+	parent[startIndex] = -1;
+	open.Push(startIndex, PathSearch::Heuristic(this->start, this->goal));
+
+	bestIndex = startIndex;
+	bestH = PathSearch::Heuristic(this->start, this->goal);
+}
+
+JumpPointSearch::Status JumpPointSearch::Step(int maxExpansions)
+{
+	if (status != Status::RUNNING)
+		return status;
+
+	for (int n = 0; n < maxExpansions; ++n)
+	{
+		if (open.Empty())
+		{
+			status = Status::PARTIAL;
+			break;
+		}
+
+		int cur = open.Pop();
+		expandedCount++;
+
+		if (cur == goalIndex)
+		{
+			status = Status::FOUND;
+			break;
+		}
+
+		float curH = PathSearch::Heuristic(grid->ToPos(cur), goal);
+		if (curH < bestH)
+		{
+			bestH = curH;
+			bestIndex = cur;
+		}
+
+		Expand(cur);
+	}
+
+	if (status != Status::RUNNING)
+		ClearRelax();
+	return status;
+}
+
+void JumpPointSearch::GetPath(vector<ivec2> &outPath) const
+{
+	outPath.clear();
+	if (status != Status::FOUND && status != Status::PARTIAL)
+		return;
+
+	// the jump points from the end back to the start, every step between two of them is the same move
+	int end = status == Status::FOUND ? goalIndex : bestIndex;
+	ivec2 pos = grid->ToPos(end);
+	outPath.push_back(pos);
+	for (int i = parent[end]; i >= 0; i = parent[i])
+	{
+		ivec2 jumpPoint = grid->ToPos(i);
+		ivec2 dir = glm::sign(jumpPoint - pos);
+		while (pos != jumpPoint)
+		{
+			pos += dir;
+			outPath.push_back(pos);
+		}
+	}
+	std::reverse(outPath.begin(), outPath.end());
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "bit_grid.hpp"
+#include "index_heap.hpp"
+#include "path_search.hpp"
+
+/*
+* jump point search on a bit-packed copy of the NavGrid, for one clearance
+*
+* the passable tiles are kept twice: row-major for the horizontal runs and transposed for the
+* vertical ones, so a straight jump reads 64 tiles at a time and finds its stop (a wall, or a side
+* that opens after a wall: a forced neighbour) with a bit scan. diagonal jumps step one tile at a
+* time and run the two straight scans from every tile.
+*
+* it finds the same (shortest) paths as PathSearch with the same rules: no corner cutting, and
+* tiles near the start and the goal only have to be walkable. only the jump points are pushed in
+* the open list, the path is filled with the tiles between them at the end.
+*/
+class JumpPointSearch
+{
+public:
+	using Status = PathSearch::Status;
+
+	JumpPointSearch() :grid(nullptr), clearance(0), status(Status::IDLE), generation(0), expandedCount(0) {}
+
+	// build the bit grids for the tiles with at least this clearance, and allocate the buffers
+	void Init(const NavGrid &grid, int clearance);
+
+	// the clearance of the tiles in [changedBegin, changedEnd) changed, update their bits
+	void Repair(glm::ivec2 changedBegin, glm::ivec2 changedEnd);
+
+	// the whole search at once, see PathSearch::FindPath()
+	bool FindPath(glm::ivec2 start, glm::ivec2 goal, std::vector<glm::ivec2> &outPath);
+
+	// the search split over several calls, see PathSearch::Begin()
+	void Begin(glm::ivec2 start, glm::ivec2 goal);
+
+	// expand at most maxExpansions jump points, return the status after it
+	Status Step(int maxExpansions);
+
+	Status GetStatus() const { return status; }
+
+	// the path of a finished (FOUND or PARTIAL) search, with every tile
+	void GetPath(std::vector<glm::ivec2> &outPath) const;
+
+	// number of jump points expanded by the last search
+	int GetExpandedCount() const { return expandedCount; }
+
+private:
+	const NavGrid *grid;
+	int clearance;
+
+	BitGrid rowBits; // bit (x, y) is set if the tile is passable
+	BitGrid colBits; // the same, transposed: bit (y, x)
+
+	// tiles made passable for the search in flight (near its start and goal)
+	std::vector<glm::ivec2> relaxed;
+
+	// the search in flight
+	Status status;
+	glm::ivec2 start;
+	glm::ivec2 goal;
+	int goalIndex;
+	int bestIndex;
+	float bestH;
+
+	// per tile, only valid when stamp == generation
+	std::vector<uint32_t> stamp;
+	std::vector<float> gScore;
+	std::vector<int> parent;
+	IndexHeap open;
+
+	uint32_t generation;
+	int expandedCount;
+
+	bool IsPassable(glm::ivec2 pos) const { return rowBits.Get(pos.x, pos.y); }
+	void SetPassable(glm::ivec2 pos, bool value);
+	void UpdateBits(glm::ivec2 pos);
+
+	void ApplyRelax();
+	void ClearRelax();
+
+	// first position from pos along a line (in the direction dir) that is blocked or has a forced neighbour
+	static int ScanLine(const BitGrid &bits, int line, int pos, int dir);
+
+	bool JumpStraight(glm::ivec2 from, glm::ivec2 dir, glm::ivec2 &jumpPoint) const;
+	bool JumpDiagonal(glm::ivec2 from, glm::ivec2 dir, glm::ivec2 &jumpPoint) const;
+
+	void Expand(int index);
+	void Visit(int from, glm::ivec2 jumpPoint);
+};
@@ -0,0 +1,117 @@
+// internal
+#include "lod_system.hpp"
+
+using namespace std;
+
+// sprites are up to ~130 px wide, keep them fully simulated until they are off screen
+const float LOD_SCREEN_MARGIN = 150.0f;
+
+float LODSystem::GetFullRadius()
+{
+	// the camera is centered on the player, so the farthest visible point is a window corner
+	return length(vec2(window_width_px, window_height_px) * 0.5f) + LOD_SCREEN_MARGIN;
+}
+
+float LODSystem::GetReducedRadius()
+{
+	return 2.0f * GetFullRadius();
+}
+
+SimTier LODSystem::NextTier(SimTier tier, float dist)
+{
+	const float fullRadius = GetFullRadius();
+	const float reducedRadius = GetReducedRadius();
+
+	// a border is crossed outward at radius + hysteresis, and inward at radius - hysteresis
+	switch (tier)
+	{
+	case SimTier::FULL:
+		if (dist > reducedRadius + LOD_HYSTERESIS)
+			return SimTier::FROZEN;
+		if (dist > fullRadius + LOD_HYSTERESIS)
+			return SimTier::REDUCED;
+		return SimTier::FULL;
+	case SimTier::REDUCED:
+		if (dist < fullRadius - LOD_HYSTERESIS)
+			return SimTier::FULL;
+		if (dist > reducedRadius + LOD_HYSTERESIS)
+			return SimTier::FROZEN;
+		return SimTier::REDUCED;
+	case SimTier::FROZEN:
+		if (dist < fullRadius - LOD_HYSTERESIS)
+			return SimTier::FULL;
+		if (dist < reducedRadius - LOD_HYSTERESIS)
+			return SimTier::REDUCED;
+		return SimTier::FROZEN;
+	}
+	return tier;
+}
+
+void LODSystem::step(float elapsed_ms, vec2 playerPos)
+{
+	frameIndex++;
+
+	auto &lod_registry = registry.simLods;
+	for (uint i = 0; i < lod_registry.size(); i++)
+	{
+		SimLod &lod = lod_registry.components[i];
+		Entity entity = lod_registry.entities[i];
+
+		if (registry.motions.has(entity))
+		{
+			float dist = length(registry.motions.get(entity).position - playerPos);
+			lod.tier = NextTier(lod.tier, dist);
+		}
+
+		lod.pending_ms = glm::min(lod.pending_ms + elapsed_ms, LOD_MAX_CATCH_UP_MS);
+		switch (lod.tier)
+		{
+		case SimTier::FULL:
+			lod.stepThisFrame = true;
+			break;
+		case SimTier::REDUCED:
+			// spread the reduced entities over the frames by their id. at a low frame rate more than
+			// one step is pending between them, it is simulated in the next frames
+			lod.stepThisFrame = (frameIndex + (unsigned int)entity) % LOD_REDUCED_INTERVAL == 0 ||
+				lod.pending_ms >= LOD_MAX_STEP_MS;
+			break;
+		case SimTier::FROZEN:
+			lod.stepThisFrame = false;
+			break;
+		}
+
+		if (lod.stepThisFrame)
+		{
+			// the rest of a long catch-up is left for the next frames. a frame longer than the cap is
+			// still simulated whole, like the entities without a SimLod
+			lod.step_ms = glm::min(lod.pending_ms, glm::max(LOD_MAX_STEP_MS, elapsed_ms));
+			lod.pending_ms -= lod.step_ms;
+		}
+		else
+		{
+			lod.step_ms = 0;
+			if (lod.tier == SimTier::FROZEN && !lod.catchUp)
+				lod.pending_ms = 0; // frozen: the skipped time is dropped
+		}
+	}
+}
+
+bool lod_should_step(Entity entity, float elapsed_ms, float &step_ms)
+{
+	if (!registry.simLods.has(entity))
+	{
+		step_ms = elapsed_ms;
+		return true;
+	}
+
+	const SimLod &lod = registry.simLods.get(entity);
+	step_ms = lod.step_ms;
+	return lod.stepThisFrame;
+}
+
+SimTier lod_get_tier(Entity entity)
+{
+	if (!registry.simLods.has(entity))
+		return SimTier::FULL;
+	return registry.simLods.get(entity).tier;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "components.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// the reduced tier is simulated once every LOD_REDUCED_INTERVAL frames
+const int LOD_REDUCED_INTERVAL = 4;
+
+// an entity has to move this far (pixels) past a tier border before its tier changes
+const float LOD_HYSTERESIS = 40.0f;
+
+// catch-up entities never keep more skipped time than this
+const float LOD_MAX_CATCH_UP_MS = 5000.0f;
+
+// the longest step of an entity in one frame (unless the frame itself is longer), a guard moves
+// about half a wall in it so it can't pass through one. longer catch-ups are spread over the next frames
+const float LOD_MAX_STEP_MS = 100.0f;
+
+/*
+* Simulation level of detail
+*
+* every entity with a SimLod component is put in a tier by its distance to the player:
+*   FULL    - on screen (plus a margin), simulated every frame
+*   REDUCED - up to one more screen away, simulated every LOD_REDUCED_INTERVAL frames with the accumulated time,
+*             or as soon as LOD_MAX_STEP_MS is pending so no time is lost at a low frame rate
+*   FROZEN  - further away, not simulated. catch-up entities get the skipped time when they are promoted,
+*             at most LOD_MAX_STEP_MS per frame, the others (lights, winds...) just continue from where they stopped
+*
+* tiers only depend on the distance and the previous tier, and the reduced frames are picked by
+* the entity id, so the result is the same for the same input.
+*/
+class LODSystem
+{
+public:
+	LODSystem() :frameIndex(0) {}
+
+	// refresh the tiers and decide which entities are simulated in this frame
+	void step(float elapsed_ms, vec2 playerPos);
+
+	// the distance where an entity leaves the full tier, and the reduced tier
+	static float GetFullRadius();
+	static float GetReducedRadius();
+
+private:
+	unsigned int frameIndex;
+
+	static SimTier NextTier(SimTier tier, float dist);
+};
+
+// returns false if the entity should not be updated in this frame, otherwise
+// step_ms is the time (ms) to simulate. entities without SimLod are always updated with elapsed_ms.
+bool lod_should_step(Entity entity, float elapsed_ms, float &step_ms);
+
+// returns the tier of an entity, FULL for entities without SimLod
+SimTier lod_get_tier(Entity entity);
@@ -41,7 +41,7 @@ int main()
 
 	// initialize the main systems
 	renderer.init(window);
-	world.init(&renderer);
+	world.init(&renderer, &physics.GetWindField());
 	eng.seed(glfwGetTime());
 
 	// variable timestep loop
@@ -0,0 +1,147 @@
+// internal
+#include "nav_grid.hpp"
+
+#include <algorithm>
+
+using namespace std;
+using glm::ivec2;
+
+void NavGrid::Build(const LevelMap &levelMap)
+{
+	rows = (int)levelMap.size();
+	cols = 0;
+	for (auto &row : levelMap)
+		cols = std::max(cols, (int)row.size());
+
+	walkable.assign(rows * cols, 0);
+	for (int y = 0; y < rows; ++y)
+	{
+		for (int x = 0; x < (int)levelMap[y].size(); ++x)
+		{
+			walkable[y * cols + x] = levelMap[y][x] != 'W';
+		}
+	}
+
+	BuildClearance();
+	version++;
+}
+
+bool NavGrid::RemoveWalls(const vector<ivec2> &tiles, ivec2 &changedBegin, ivec2 &changedEnd)
+{
+	ivec2 removedMin(cols, rows);
+	ivec2 removedMax(-1);
+	for (ivec2 pos : tiles)
+	{
+		if (!IsValid(pos) || walkable[ToIndex(pos)])
+			continue;
+		walkable[ToIndex(pos)] = 1;
+		removedMin = glm::min(removedMin, pos);
+		removedMax = glm::max(removedMax, pos);
+	}
+	if (removedMax.x < 0)
+		return false;
+
+	// the clearance is capped, so only the tiles that close to a removed wall can change
+	ivec2 regionBegin = glm::max(removedMin - NAV_MAX_CLEARANCE, ivec2(0));
+	ivec2 regionEnd = glm::min(removedMax + NAV_MAX_CLEARANCE + 1, ivec2(cols, rows));
+
+	changedBegin = ivec2(cols, rows);
+	changedEnd = ivec2(0);
+	for (int y = regionBegin.y; y < regionEnd.y; ++y)
+	{
+		for (int x = regionBegin.x; x < regionEnd.x; ++x)
+		{
+			int i = y * cols + x;
+			int c = ComputeClearance(ivec2(x, y));
+			if (c == clearance[i])
+				continue;
+			clearance[i] = (uint8_t)c;
+			changedBegin = glm::min(changedBegin, ivec2(x, y));
+			changedEnd = glm::max(changedEnd, ivec2(x + 1, y + 1));
+		}
+	}
+
+	version++;
+	return true;
+}
+
+int NavGrid::ComputeClearance(ivec2 pos) const
+{
+	if (!walkable[ToIndex(pos)])
+		return 0;
+
+	// the outside of the map is a wall as well
+	int best = std::min(std::min(pos.x, cols - 1 - pos.x), std::min(pos.y, rows - 1 - pos.y)) + 1;
+	best = std::min(best, NAV_MAX_CLEARANCE);
+
+	// rings of growing radius, the first ring with a wall gives the distance
+	for (int r = 1; r < best; ++r)
+	{
+		for (int d = -r; d <= r; ++d)
+		{
+			const ivec2 ring[4] = { pos + ivec2(d, -r), pos + ivec2(d, r), pos + ivec2(-r, d), pos + ivec2(r, d) };
+			for (ivec2 p : ring)
+			{
+				if (IsValid(p) && !walkable[ToIndex(p)])
+					return r;
+			}
+		}
+	}
+	return best;
+}
+
+ivec2 NavGrid::Clamp(ivec2 pos) const
+{
+	return glm::clamp(pos, ivec2(0), ivec2(cols - 1, rows - 1));
+}
+
+void NavGrid::BuildClearance()
+{
+	// multi-source BFS from all the walls, with 8 neighbours the BFS depth is the chebyshev distance
+	clearance.assign(rows * cols, (uint8_t)NAV_MAX_CLEARANCE);
+
+	vector<int> frontier;
+	frontier.reserve(rows * cols);
+	for (int i = 0; i < rows * cols; ++i)
+	{
+		if (!walkable[i])
+		{
+			clearance[i] = 0;
+			frontier.push_back(i);
+		}
+	}
+
+	// the outside of the map is a wall as well
+	for (int y = 0; y < rows; ++y)
+	{
+		for (int x = 0; x < cols; ++x)
+		{
+			int border = std::min(std::min(x, cols - 1 - x), std::min(y, rows - 1 - y)) + 1;
+			int i = y * cols + x;
+			clearance[i] = (uint8_t)std::min((int)clearance[i], border);
+		}
+	}
+
+	size_t head = 0;
+	while (head < frontier.size())
+	{
+		int cur = frontier[head++];
+		int next = clearance[cur] + 1;
+		if (next >= NAV_MAX_CLEARANCE)
+			continue;
+
+		ivec2 pos = ToPos(cur);
+		for (ivec2 dir : NAV_NEIGHBOURS)
+		{
+			ivec2 newPos = pos + dir;
+			if (!IsValid(newPos))
+				continue;
+			int n = ToIndex(newPos);
+			if (clearance[n] > next)
+			{
+				clearance[n] = (uint8_t)next;
+				frontier.push_back(n);
+			}
+		}
+	}
+}
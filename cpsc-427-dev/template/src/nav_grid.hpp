@@ -0,0 +1,78 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+// only glm, so the pathfinding code can be used without a window or OpenGL
+#include <glm/vec2.hpp>
+#include <glm/ext/vector_int2.hpp>
+#include <glm/common.hpp>
+
+/*
+* the navigation grid of a level, built once when the level is loaded
+*
+* tiles are stored row-major in flat arrays, index = row * cols + col.
+* besides walkability, every tile stores its clearance: the chebyshev distance (in tiles)
+* to the nearest wall, capped at NAV_MAX_CLEARANCE. a wall has clearance 0, a tile next
+* to a wall has clearance 1, and so on. a big character can stand on a tile when the
+* clearance of the tile is at least its own clearance requirement.
+*/
+const int NAV_MAX_CLEARANCE = 8;
+
+// the 8 neighbours of a tile, the 4 straight ones first, and the length of each move
+// they come in opposite pairs, the opposite of move d is move (d ^ 1)
+const glm::ivec2 NAV_NEIGHBOURS[8] = { {1,0},{-1,0},{0,1},{0,-1},{1,1},{-1,-1},{1,-1},{-1,1} };
+const float NAV_STEP_COST[8] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+// a diagonal move (4..7) can't cut a corner, it needs both straight neighbours it passes between
+const int NAV_DIAGONAL_SIDES[8][2] = { {-1,-1},{-1,-1},{-1,-1},{-1,-1},{0,2},{1,3},{0,3},{1,2} };
+
+class NavGrid
+{
+public:
+	using LevelMap = std::vector<std::vector<char>>;
+
+	NavGrid() :rows(0), cols(0), version(0) {}
+
+	// build from a level map, 'W' is a wall and every other character is walkable
+	// tiles outside of a (shorter) row are treated as walls
+	void Build(const LevelMap &levelMap);
+
+	// make wall tiles walkable (e.g. broken by the hammer) and update the clearance around them.
+	// return false if nothing changed, otherwise changedBegin/changedEnd is the rectangle
+	// [begin, end) of the tiles whose clearance changed
+	bool RemoveWalls(const std::vector<glm::ivec2> &tiles, glm::ivec2 &changedBegin, glm::ivec2 &changedEnd);
+
+	// incremented every time the grid changes
+	unsigned int GetVersion() const { return version; }
+
+	int GetRows() const { return rows; }
+	int GetCols() const { return cols; }
+	int GetSize() const { return rows * cols; }
+
+	bool IsValid(glm::ivec2 pos) const { return 0 <= pos.y && pos.y < rows && 0 <= pos.x && pos.x < cols; }
+	int ToIndex(glm::ivec2 pos) const { return pos.y * cols + pos.x; }
+	glm::ivec2 ToPos(int index) const { return glm::ivec2(index % cols, index / cols); }
+
+	// clamp a position into the grid
+	glm::ivec2 Clamp(glm::ivec2 pos) const;
+
+	bool IsWalkable(int index) const { return walkable[index] != 0; }
+	int GetClearance(int index) const { return clearance[index]; }
+
+	// chebyshev distance between two tiles
+	static int Chebyshev(glm::ivec2 a, glm::ivec2 b) { return glm::max(glm::abs(a.x - b.x), glm::abs(a.y - b.y)); }
+
+private:
+	int rows;
+	int cols;
+	unsigned int version;
+	std::vector<uint8_t> walkable;
+	std::vector<uint8_t> clearance;
+
+	void BuildClearance();
+
+	// clearance of one tile, by looking for the nearest wall around it
+	int ComputeClearance(glm::ivec2 pos) const;
+};
@@ -0,0 +1,86 @@
+// internal
+#include "parallel_for.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+ParallelFor::ParallelFor() :quit(false), generation(0), body(nullptr), count(0), chunkSize(1), nextChunk(0), chunkCount(0), workersRunning(0)
+{
+	int threads = min((int)thread::hardware_concurrency(), PARALLEL_MAX_THREADS);
+	for (int i = 1; i < threads; ++i)
+		workers.emplace_back(&ParallelFor::WorkerMain, this);
+}
+
+ParallelFor::~ParallelFor()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	start.notify_all();
+	for (thread &worker : workers)
+		worker.join();
+}
+
+void ParallelFor::Run(int count, int minChunk, const function<void(int, int)> &body)
+{
+	if (count <= 0)
+		return;
+
+	// a few chunks per thread, so a slow chunk doesn't hold the others back
+	int chunks = min(GetThreadCount() * 4, max(count / max(minChunk, 1), 1));
+	if (chunks <= 1 || workers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		this->body = &body;
+		this->count = count;
+		chunkSize = (count + chunks - 1) / chunks;
+		chunkCount = (count + chunkSize - 1) / chunkSize;
+		nextChunk = 0;
+		workersRunning = workers.size();
+		generation++;
+	}
+	start.notify_all();
+
+	Work();
+
+	unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this]() { return workersRunning == 0; });
+	this->body = nullptr;
+}
+
+void ParallelFor::Work()
+{
+	for (int chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+	{
+		int begin = chunk * chunkSize;
+		(*body)(begin, min(begin + chunkSize, count));
+	}
+}
+
+void ParallelFor::WorkerMain()
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			unique_lock<std::mutex> lock(mutex);
+			start.wait(lock, [&]() { return quit || generation != seen; });
+			if (quit)
+				return;
+			seen = generation;
+		}
+
+		Work();
+
+		lock_guard<std::mutex> lock(mutex);
+		if (--workersRunning == 0)
+			finished.notify_one();
+	}
+}
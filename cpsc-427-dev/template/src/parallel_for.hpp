@@ -0,0 +1,57 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// never more worker threads than this, the simulation loops are short
+const int PARALLEL_MAX_THREADS = 8;
+
+/*
+* fork-join loops on a small pool of threads that live as long as the pool
+*
+* Run() splits [0, count) in chunks, the workers and the calling thread take chunks until none is
+* left, and Run() returns when every worker is done with the loop (so none of them touches it
+* late). the body of a loop must only write data of its own indices.
+* with one hardware thread (or a short loop) everything runs on the calling thread.
+*/
+class ParallelFor
+{
+public:
+	ParallelFor();
+	~ParallelFor();
+
+	ParallelFor(const ParallelFor &) = delete;
+	ParallelFor &operator=(const ParallelFor &) = delete;
+
+	// body(begin, end) for chunks of at least minChunk indices
+	void Run(int count, int minChunk, const std::function<void(int, int)> &body);
+
+	// the workers plus the calling thread
+	int GetThreadCount() const { return (int)workers.size() + 1; }
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable finished;
+	bool quit;
+	unsigned int generation; // incremented for every loop, a worker waits for the next one
+
+	// the loop in flight
+	const std::function<void(int, int)> *body;
+	int count;
+	int chunkSize;
+	std::atomic<int> nextChunk;
+	int chunkCount;
+	size_t workersRunning; // workers that didn't finish the loop in flight, protected by mutex
+
+	void WorkerMain();
+
+	// take chunks until none is left
+	void Work();
+};
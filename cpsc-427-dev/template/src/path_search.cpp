@@ -0,0 +1,156 @@
+// internal
+#include "path_search.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using glm::ivec2;
+
+void PathSearch::Init(const NavGrid &grid)
+{
+	this->grid = &grid;
+
+	int size = grid.GetSize();
+	stamp.assign(size, 0);
+	gScore.assign(size, 0);
+	parent.assign(size, -1);
+	open.Init(size);
+
+	status = Status::IDLE;
+	generation = 0;
+	expandedCount = 0;
+}
+
+float PathSearch::Heuristic(ivec2 a, ivec2 b)
+{
+	int dx = abs(a.x - b.x);
+	int dy = abs(a.y - b.y);
+	return (float)(dx + dy) + (NAV_STEP_COST[4] - 2.0f) * (float)std::min(dx, dy);
+}
+
+bool PathSearch::IsPassable(int index, ivec2 pos) const
+{
+	if (grid->GetClearance(index) >= clearance)
+		return true;
+	if (!grid->IsWalkable(index))
+		return false;
+	return NavGrid::Chebyshev(pos, start) < clearance || NavGrid::Chebyshev(pos, goal) < clearance;
+}
+
+bool PathSearch::FindPath(ivec2 start, ivec2 goal, int clearance, vector<ivec2> &outPath)
+{
+	Begin(start, goal, clearance);
+	Step(INT_MAX);
+	GetPath(outPath);
+	return status == Status::FOUND;
+}
+
+void PathSearch::Begin(ivec2 start, ivec2 goal, int clearance)
+{
+	assert(grid != nullptr && (int)stamp.size() == grid->GetSize() && "PathSearch::Init() not called");
+
+	this->start = grid->Clamp(start);
+	this->goal = grid->Clamp(goal);
+	this->clearance = clearance;
+	status = Status::RUNNING;
+	expandedCount = 0;
+
+	// new generation, all the tiles become unvisited
+	if (++generation == 0)
+	{
+		std::fill(stamp.begin(), stamp.end(), 0);
+		generation = 1;
+	}
+	open.Clear();
+
+	int startIndex = grid->ToIndex(this->start);
+	goalIndex = grid->ToIndex(this->goal);
+
+	stamp[startIndex] = generation;
+	gScore[startIndex] = 0;
+	parent[startIndex] = -1;
+	open.Push(startIndex, Heuristic(this->start, this->goal));
+
+	bestIndex = startIndex;
+	bestH = Heuristic(this->start, this->goal);
+}
+
+PathSearch::Status PathSearch::Step(int maxExpansions)
+{
+	if (status != Status::RUNNING)
+		return status;
+
+	for (int n = 0; n < maxExpansions; ++n)
+	{
+		if (open.Empty())
+		{
+			status = Status::PARTIAL;
+			return status;
+		}
+
+		int cur = open.Pop();
+		expandedCount++;
+
+		if (cur == goalIndex)
+		{
+			status = Status::FOUND;
+			return status;
+		}
+
+		ivec2 curPos = grid->ToPos(cur);
+		float curH = Heuristic(curPos, goal);
+		if (curH < bestH)
+		{
+			bestH = curH;
+			bestIndex = cur;
+		}
+
+		bool passable[8];
+		for (int d = 0; d < 8; ++d)
+		{
+			ivec2 newPos = curPos + NAV_NEIGHBOURS[d];
+			passable[d] = grid->IsValid(newPos) && IsPassable(grid->ToIndex(newPos), newPos);
+			if (d >= 4)
+				passable[d] = passable[d] && passable[NAV_DIAGONAL_SIDES[d][0]] && passable[NAV_DIAGONAL_SIDES[d][1]];
+			if (!passable[d])
+				continue;
+
+			int next = grid->ToIndex(newPos);
+			float g = gScore[cur] + NAV_STEP_COST[d];
+
+			if (stamp[next] != generation)
+			{
+				// first visit
+				stamp[next] = generation;
+				gScore[next] = g;
+				parent[next] = cur;
+				open.Push(next, g + Heuristic(newPos, goal));
+			}
+			else if (open.Contains(next) && g < gScore[next])
+			{
+				// shorter way to an open tile, the heuristic is consistent so closed tiles are final
+				gScore[next] = g;
+				parent[next] = cur;
+				open.Decrease(next, g + Heuristic(newPos, goal));
+			}
+		}
+	}
+
+	return status;
+}
+
+void PathSearch::GetPath(vector<ivec2> &outPath) const
+{
+	outPath.clear();
+	if (status != Status::FOUND && status != Status::PARTIAL)
+		return;
+
+	// walk back from the end tile, then reverse
+	int end = status == Status::FOUND ? goalIndex : bestIndex;
+	for (int i = end; i >= 0; i = parent[i])
+		outPath.push_back(grid->ToPos(i));
+	std::reverse(outPath.begin(), outPath.end());
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "index_heap.hpp"
+
+/*
+* A* on a NavGrid, with 8 neighbours and the octile distance as heuristic
+*
+* all the per-tile buffers are allocated by Init() for the size of the grid, a search only
+* stamps them with its own generation number, so FindPath() doesn't allocate
+* (outPath only grows the first time it is used).
+*
+* a tile is passable when its clearance >= the clearance asked by the caller. tiles around
+* the start and the goal only have to be walkable, so a character standing next to a wall
+* can still leave, and can still reach a target that is next to a wall.
+* diagonal moves can't cut a corner.
+*/
+class PathSearch
+{
+public:
+	enum class Status { IDLE, RUNNING, FOUND, PARTIAL };
+
+	PathSearch() :grid(nullptr), status(Status::IDLE), generation(0), expandedCount(0) {}
+
+	// allocate the buffers for a grid, has to be called again if the size of the grid changed
+	void Init(const NavGrid &grid);
+
+	// find the shortest path from start to goal, the path is written to outPath from start to goal (both included).
+	// return false if the goal can't be reached, then outPath goes to the reachable tile closest to the goal.
+	bool FindPath(glm::ivec2 start, glm::ivec2 goal, int clearance, std::vector<glm::ivec2> &outPath);
+
+	// the same search split over several calls (frames): Begin() once, then Step() until it's not RUNNING.
+	// the state is kept in the search, so there is only one search in flight per PathSearch.
+	void Begin(glm::ivec2 start, glm::ivec2 goal, int clearance);
+
+	// expand at most maxExpansions tiles, return the status after it
+	Status Step(int maxExpansions);
+
+	Status GetStatus() const { return status; }
+
+	// the path of a finished (FOUND or PARTIAL) search
+	void GetPath(std::vector<glm::ivec2> &outPath) const;
+
+	// number of tiles expanded by the last search
+	int GetExpandedCount() const { return expandedCount; }
+
+	// octile distance between two tiles, in tiles
+	static float Heuristic(glm::ivec2 a, glm::ivec2 b);
+
+private:
+	const NavGrid *grid;
+
+	// the search in flight
+	Status status;
+	glm::ivec2 start;
+	glm::ivec2 goal;
+	int clearance;
+	int goalIndex;
+	int bestIndex; // the closest tile to the goal, used when the goal can't be reached
+	float bestH;
+
+	// per tile, only valid when stamp == generation
+	std::vector<uint32_t> stamp;
+	std::vector<float> gScore;
+	std::vector<int> parent;
+
+	// open tiles ordered by f score, a stamped tile that is not in the heap is closed
+	IndexHeap open;
+
+	uint32_t generation;
+	int expandedCount;
+
+	bool IsPassable(int index, glm::ivec2 pos) const;
+};
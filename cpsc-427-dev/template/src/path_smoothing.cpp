@@ -0,0 +1,55 @@
+// stlib
+#include <cassert>
+#include <cmath>
+
+// internal
+#include "path_smoothing.hpp"
+#include "grid_raycast.hpp"
+
+using namespace std;
+using glm::ivec2;
+using glm::vec2;
+
+void path_string_pull(const NavGrid &grid, vector<ivec2> &path, int clearance, ivec2 start, ivec2 goal)
+{
+	if (path.size() <= 2)
+		return;
+
+	auto Visible = [&](ivec2 from, ivec2 to) { return grid_line_of_sight(grid, from, to, clearance, start, goal); };
+
+	// compacted in place, a tile is only overwritten once the pull is past it
+	size_t kept = 0;
+	size_t anchor = 0;
+	while (anchor + 1 < path.size())
+	{
+		size_t next = anchor + 1;
+		while (next + 1 < path.size() && Visible(path[anchor], path[next + 1]))
+			next++;
+
+		path[++kept] = path[next];
+		anchor = next;
+	}
+	path.resize(kept + 1);
+
+#ifndef NDEBUG
+	// between its kept tiles (from the search), the pulled path only crosses tiles the search
+	// accepts. the lines are sampled every quarter of a tile
+	auto Passable = [&](ivec2 tile)
+	{
+		int index = grid.ToIndex(tile);
+		return grid.GetClearance(index) >= clearance || (grid.IsWalkable(index) &&
+			(NavGrid::Chebyshev(tile, start) < clearance || NavGrid::Chebyshev(tile, goal) < clearance));
+	};
+	for (size_t i = 1; i < path.size(); ++i)
+	{
+		vec2 from = vec2(path[i - 1]) + 0.5f, to = vec2(path[i]) + 0.5f;
+		int samples = NavGrid::Chebyshev(path[i - 1], path[i]) * 4;
+		for (int j = 0; j <= samples; ++j)
+		{
+			vec2 point = glm::mix(from, to, (float)j / samples);
+			ivec2 tile(floor(point.x), floor(point.y));
+			assert((tile == path[i - 1] || tile == path[i] || Passable(tile)) && "path_string_pull() crossed a tile the search rejects");
+		}
+	}
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// stlib
+#include <vector>
+
+#include "nav_grid.hpp"
+
+// string pulling: remove the tiles of a path (from a grid search) that can be skipped by walking
+// straight. from every kept tile the path goes to the farthest following tile in line of sight,
+// the line has to stay on tiles the search could step on: tiles with at least the clearance, or
+// walkable tiles closer than the clearance to the start or the goal of the search (it relaxes the
+// clearance there). the first and the last tile are always kept.
+void path_string_pull(const NavGrid &grid, std::vector<glm::ivec2> &path, int clearance, glm::ivec2 start, glm::ivec2 goal);
@@ -0,0 +1,143 @@
+// internal
+#include "path_worker.hpp"
+
+#include <chrono>
+
+using namespace std;
+using glm::ivec2;
+
+// an idle worker checks the job queue at least this often, in case a wake-up was missed
+const chrono::milliseconds PATH_WORKER_IDLE_WAIT(2);
+
+void PathWorker::Start(const NavGrid::LevelMap &levelMap, int clearance, unsigned int mapVersion)
+{
+	Stop();
+
+	// the threads don't run yet, everything can be set directly
+	this->levelMap = levelMap;
+	this->clearance = clearance;
+	this->mapVersion = mapVersion;
+	jobs.Init(PATH_WORKER_QUEUE_SIZE);
+	results.Init(PATH_WORKER_QUEUE_SIZE);
+
+	running = true;
+	thread = std::thread(&PathWorker::Run, this);
+}
+
+void PathWorker::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(wakeMutex);
+		running = false;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+bool PathWorker::SubmitFind(unsigned int guardId, ivec2 start, ivec2 goal, unsigned int mapVersion)
+{
+	PathJob *job = jobs.BeginPush();
+	if (job == nullptr)
+		return false;
+
+	job->type = PathJob::Type::FIND;
+	job->guardId = guardId;
+	job->start = start;
+	job->goal = goal;
+	job->mapVersion = mapVersion;
+	jobs.EndPush();
+	wake.notify_one();
+	return true;
+}
+
+bool PathWorker::SubmitRemoveWalls(const vector<ivec2> &tiles, unsigned int mapVersion)
+{
+	PathJob *job = jobs.BeginPush();
+	if (job == nullptr)
+		return false;
+
+	job->type = PathJob::Type::REMOVE_WALLS;
+	job->tiles = tiles;
+	job->mapVersion = mapVersion;
+	jobs.EndPush();
+	wake.notify_one();
+	return true;
+}
+
+void PathWorker::Run()
+{
+	grid.Build(levelMap);
+	search.Init(grid, clearance);
+
+	useHierarchy = grid.GetSize() >= AI_HPA_MIN_TILES;
+	if (useHierarchy)
+		hierarchy.Build(grid, AI_HPA_CLUSTER_SIZE, clearance);
+
+	while (running)
+	{
+		PathJob *job = jobs.Front();
+		if (job == nullptr)
+		{
+			unique_lock<mutex> lock(wakeMutex);
+			wake.wait_for(lock, PATH_WORKER_IDLE_WAIT, [this]() { return !running || jobs.Front() != nullptr; });
+			continue;
+		}
+
+		if (job->type == PathJob::Type::REMOVE_WALLS)
+		{
+			RemoveWalls(*job);
+		}
+		else
+		{
+			// the main thread is behind on reading the results, the job waits
+			PathResult *result = results.BeginPush();
+			if (result == nullptr)
+			{
+				this_thread::yield();
+				continue;
+			}
+			Find(*job, *result);
+			results.EndPush();
+		}
+		jobs.Pop();
+	}
+}
+
+void PathWorker::RemoveWalls(const PathJob &job)
+{
+	mapVersion = job.mapVersion;
+
+	ivec2 changedBegin, changedEnd;
+	if (!grid.RemoveWalls(job.tiles, changedBegin, changedEnd))
+		return;
+
+	search.Repair(changedBegin, changedEnd);
+	if (useHierarchy)
+		hierarchy.Repair(changedBegin, changedEnd);
+}
+
+void PathWorker::Find(const PathJob &job, PathResult &result)
+{
+	result.guardId = job.guardId;
+	result.goal = job.goal;
+	result.mapVersion = mapVersion;
+
+	if (useHierarchy)
+	{
+		// the abstract search is small, only the way to the next node is refined
+		result.path.clear();
+		result.found = hierarchy.FindAbstractPath(job.start, job.goal, abstractPath) && abstractPath.size() >= 2 &&
+			hierarchy.RefineSegment(abstractPath[0], abstractPath[1], result.path);
+		result.expandedCount = hierarchy.GetExpandedCount();
+	}
+	else
+	{
+		result.found = search.FindPath(job.start, job.goal, result.path);
+		result.expandedCount = search.GetExpandedCount();
+	}
+
+	path_string_pull(grid, result.path, clearance, grid.Clamp(job.start), grid.Clamp(job.goal));
+}
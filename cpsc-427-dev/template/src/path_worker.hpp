@@ -0,0 +1,104 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nav_grid.hpp"
+#include "jump_point_search.hpp"
+#include "hpa_star.hpp"
+#include "path_smoothing.hpp"
+#include "spsc_queue.hpp"
+
+// levels with at least this many tiles use hierarchical searches (HPA*) instead of the flat search
+const int AI_HPA_MIN_TILES = 250 * 250;
+const int AI_HPA_CLUSTER_SIZE = 16;
+
+// jobs and results that can wait in the queues at the same time
+const int PATH_WORKER_QUEUE_SIZE = 256;
+
+// a job for the worker, searches and wall changes are done in the order they were submitted
+struct PathJob
+{
+	enum class Type { FIND, REMOVE_WALLS };
+
+	Type type = Type::FIND;
+	unsigned int guardId = 0; // the entity id, an Entity can't be created on the worker
+	glm::ivec2 start = { 0, 0 };
+	glm::ivec2 goal = { 0, 0 };
+	unsigned int mapVersion = 0; // the version of the main grid when the job was submitted
+	std::vector<glm::ivec2> tiles; // REMOVE_WALLS: the broken walls
+};
+
+struct PathResult
+{
+	unsigned int guardId = 0;
+	glm::ivec2 goal = { 0, 0 };
+	unsigned int mapVersion = 0; // the walls the path was searched on
+	bool found = false; // false: partial path toward the goal, or empty if there is no way at all
+	int expandedCount = 0;
+	std::vector<glm::ivec2> path; // smoothed, only the tiles where the path turns
+};
+
+/*
+* runs the guard path searches on a background thread, and smooths their paths (string pulling)
+*
+* the worker keeps its own copy of the navigation grid, it gets the broken walls as jobs so the
+* main thread never shares a grid with it. jobs go in and results come back through two lock-free
+* single-producer / single-consumer rings, the main thread only polls them and never waits.
+* an idle worker sleeps on a condition variable. the main thread wakes it without taking the
+* lock, a missed wake-up only costs the short timeout of the wait.
+*/
+class PathWorker
+{
+public:
+	PathWorker() :running(false), clearance(0), mapVersion(0), useHierarchy(false) {}
+	~PathWorker() { Stop(); }
+
+	PathWorker(const PathWorker &) = delete;
+	PathWorker &operator=(const PathWorker &) = delete;
+
+	// stop the previous level's worker and start one on this level. the grid (and the HPA* graph on
+	// big levels) is built on the worker, the searches submitted meanwhile wait for it
+	void Start(const NavGrid::LevelMap &levelMap, int clearance, unsigned int mapVersion);
+
+	// wait for the search in flight and stop the thread, the jobs and results left are dropped
+	void Stop();
+
+	// main thread only, return false if the job queue is full
+	bool SubmitFind(unsigned int guardId, glm::ivec2 start, glm::ivec2 goal, unsigned int mapVersion);
+	bool SubmitRemoveWalls(const std::vector<glm::ivec2> &tiles, unsigned int mapVersion);
+
+	// main thread only: the oldest finished result, nullptr if none. it stays valid until PopResult()
+	PathResult *PeekResult() { return results.Front(); }
+	void PopResult() { results.Pop(); }
+
+	// jobs not picked up by the worker yet (approximate)
+	int GetPendingJobs() const { return (int)jobs.Size(); }
+
+private:
+	std::thread thread;
+	std::atomic<bool> running;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	SpscQueue<PathJob> jobs; // main thread -> worker
+	SpscQueue<PathResult> results; // worker -> main thread
+
+	// only used by the worker thread
+	NavGrid::LevelMap levelMap;
+	int clearance;
+	unsigned int mapVersion;
+	NavGrid grid;
+	JumpPointSearch search;
+	bool useHierarchy;
+	HPAStar hierarchy;
+	std::vector<glm::ivec2> abstractPath;
+
+	void Run();
+	void RemoveWalls(const PathJob &job);
+	void Find(const PathJob &job, PathResult &result);
+};
@@ -0,0 +1,56 @@
+// internal
+#include "perception_system.hpp"
+
+#include "world_init.hpp"
+#include "grid_raycast.hpp"
+
+using namespace std;
+
+// a guard slower than this (pixels per second) keeps looking where it looked before
+const float SIGHT_MIN_SPEED = 1.0f;
+
+void PerceptionSystem::step(const NavGrid &grid, vec2 playerPos)
+{
+	rayCount = 0;
+	cachedCount = 0;
+
+	// entities are placed at (col * WALL_SIZE, row * WALL_SIZE), so round to the nearest tile
+	auto ToTile = [](vec2 position) { return ivec2(floor(position / WALL_SIZE + 0.5f)); };
+
+	ivec2 playerTile = ToTile(playerPos);
+	const float cosHalfAngle = cos(SIGHT_HALF_ANGLE);
+
+	auto &sight_registry = registry.sights;
+	for (uint i = 0; i < sight_registry.size(); i++)
+	{
+		Sight &sight = sight_registry.components[i];
+		const Motion &motion = registry.motions.get(sight_registry.entities[i]);
+
+		if (length(motion.velocity) > SIGHT_MIN_SPEED)
+			sight.facing = normalize(motion.velocity);
+
+		// the cone first, it's much cheaper than the ray
+		vec2 toPlayer = playerPos - motion.position;
+		float dist = length(toPlayer);
+		sight.seesPlayer = false;
+		if (dist > SIGHT_RANGE_TILES * WALL_SIZE)
+			continue;
+		if (dist > 0 && dot(toPlayer / dist, sight.facing) < cosHalfAngle)
+			continue;
+
+		ivec2 guardTile = ToTile(motion.position);
+		if (sight.rayMapVersion != grid.GetVersion() || sight.rayFrom != guardTile || sight.rayTo != playerTile)
+		{
+			sight.rayFrom = guardTile;
+			sight.rayTo = playerTile;
+			sight.rayMapVersion = grid.GetVersion();
+			sight.rayClear = grid_line_of_sight(grid, guardTile, playerTile);
+			rayCount++;
+		}
+		else
+		{
+			cachedCount++;
+		}
+		sight.seesPlayer = sight.rayClear;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "components.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "nav_grid.hpp"
+
+// how far (tiles) a guard sees, and half the angle of its view cone
+const float SIGHT_RANGE_TILES = 12.0f;
+const float SIGHT_HALF_ANGLE = 50.0f * 3.14159265f / 180.0f;
+
+/*
+* what the guards see
+*
+* every frame each guard with a Sight checks whether the player is in its view cone (in front of
+* it, closer than SIGHT_RANGE_TILES) and then casts a ray through the wall grid from its tile to the
+* player's tile (grid_line_of_sight, a DDA). the cone test is a dot product, only the guards that
+* pass it cast a ray, and the result of a ray is kept in the Sight and reused while both of its
+* tiles and the walls stay the same, so most frames cost no ray at all.
+*/
+class PerceptionSystem
+{
+public:
+	PerceptionSystem() :rayCount(0), cachedCount(0) {}
+
+	// refresh the Sight of every guard
+	void step(const NavGrid &grid, vec2 playerPos);
+
+	// rays cast in the last step, and rays answered from the cache
+	int GetRayCount() const { return rayCount; }
+	int GetCachedCount() const { return cachedCount; }
+
+private:
+	int rayCount;
+	int cachedCount;
+};
@@ -1,6 +1,7 @@
 // internal
 #include "physics_system.hpp"
 #include "world_init.hpp"
+#include "lod_system.hpp"
 
 using namespace std;
 
@@ -43,52 +44,42 @@ void PhysicsSystem::step(float elapsed_ms)
 		Motion& motion = motion_registry.components[i];
 		Entity entity = motion_registry.entities[i];
 
+		// far away entities are not moved in every frame
+		float step_ms;
+		if (!lod_should_step(entity, elapsed_ms, step_ms))
+			continue;
+
 		if (registry.lights.has(entity)) 
 		{
 			// light
-			float step_seconds = elapsed_ms / 1000.f;
+			float step_seconds = step_ms / 1000.f;
 			motion.angle += motion.velocity.x * step_seconds;
 		} 
 		else if (!registry.stopeds.has(entity) && !registry.wins.has(entity))  // not stopeds and wins
 		{
-			float step_seconds = elapsed_ms / 1000.f;
+			float step_seconds = step_ms / 1000.f;
 			motion.position.x += motion.velocity.x * step_seconds;
 			motion.position.y += motion.velocity.y * step_seconds;
 		}
 
 	}
 
-	// calc all the explodeds 's life and erase dead instance
-	for (auto &e : registry.explodeds.entities)
-	{
-		Exploded &inst = registry.explodeds.get(e);
-		inst.life -= elapsed_ms;
-		if (inst.life <= 0)
-		{
-			registry.remove_all_components_of(e);
-			continue;
-		}
-
-		// rotate it
-		auto &motion = registry.motions.get(e);
-		motion.angle += 0.1 * elapsed_ms;
-
-		float lifeCoef = inst.life / inst.initLife; // [0,1], 0 for dead; 1 for born
-		motion.scale = inst.initSize * lifeCoef;
-	}
-
 	// be influence by wind
-	for (auto &inst : registry.winds.components)
-	{
-		Entity player = registry.players.entities[0];
-		inst.Influence(registry.motions.get(player));
-	}
+	ApplyWind(elapsed_ms);
 
 	// Check for collisions between all moving entities
     ComponentContainer<Motion> &motion_container = registry.motions;
 
+	// frozen entities are far away from the player, they don't take part in collisions
+	std::vector<char> frozen(motion_container.components.size());
+	for (uint i = 0; i < motion_container.components.size(); i++)
+		frozen[i] = lod_get_tier(motion_container.entities[i]) == SimTier::FROZEN;
+
 	for(uint i = 0; i<motion_container.components.size(); i++)
 	{
+		if (frozen[i])
+			continue;
+
 		Motion motion_i = motion_container.components[i];
 		Motion motion_ic = motion_i;
 		Entity entity_i = motion_container.entities[i];
@@ -96,6 +87,9 @@ void PhysicsSystem::step(float elapsed_ms)
 		// note starting j at i+1 to compare all (i,j) pairs only once (and to not compare with itself)
 		for(uint j = i+1; j<motion_container.components.size(); j++)
 		{
+			if (frozen[j])
+				continue;
+
 			Motion motion_j = motion_container.components[j];
 			Motion motion_jc = motion_j;
 			Entity entity_j = motion_container.entities[j];
@@ -171,4 +165,33 @@ void PhysicsSystem::step(float elapsed_ms)
 			// !!! TODO A2: implement debug bounding boxes instead of crosses
 		}
 	}
-}
\ No newline at end of file
+}
+
+void PhysicsSystem::ApplyWind(float elapsed_ms)
+{
+	if (registry.winds.size() == 0)
+		return;
+
+	// the player is carried by the wind until it walks again
+	for (Entity player : registry.players.entities)
+	{
+		Motion &motion = registry.motions.get(player);
+		vec2 flow = windField.Sample(motion.position);
+		if (flow != vec2(0))
+			motion.velocityGoal = flow;
+	}
+
+	// the others drift with the wind on top of their own velocity
+	auto Drift = [&](Entity entity)
+	{
+		float step_ms;
+		if (!lod_should_step(entity, elapsed_ms, step_ms))
+			return;
+
+		Motion &motion = registry.motions.get(entity);
+		motion.position += windField.Sample(motion.position) * (step_ms / 1000.f);
+	};
+
+	for (Entity guard : registry.guards.entities)
+		Drift(guard);
+}
@@ -4,6 +4,7 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
+#include "force_field.hpp"
 
 // A simple physics system that moves rigid bodies and checks for collision
 class PhysicsSystem
@@ -14,4 +15,15 @@ public:
 	PhysicsSystem()
 	{
 	}
+
+	// the flow of the winds, built by the level when it is loaded. the bodies moved outside of the
+	// physics system sample it too
+	ForceField &GetWindField() { return windField; }
+
+private:
+	// the winds of the current level, rasterised per tile
+	ForceField windField;
+
+	// push the dynamic bodies (player, guards) by the wind at their position
+	void ApplyWind(float elapsed_ms);
 };
\ No newline at end of file
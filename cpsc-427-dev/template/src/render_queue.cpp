@@ -0,0 +1,91 @@
+// internal
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+const int RENDER_KEY_INDEX_SHIFT = 0;
+const int RENDER_KEY_TEXTURE_SHIFT = RENDER_KEY_INDEX_SHIFT + RENDER_KEY_INDEX_BITS;
+const int RENDER_KEY_EFFECT_SHIFT = RENDER_KEY_TEXTURE_SHIFT + RENDER_KEY_TEXTURE_BITS;
+const int RENDER_KEY_DEPTH_SHIFT = RENDER_KEY_EFFECT_SHIFT + RENDER_KEY_EFFECT_BITS;
+const int RENDER_KEY_LAYER_SHIFT = RENDER_KEY_DEPTH_SHIFT + RENDER_KEY_DEPTH_BITS;
+static_assert(RENDER_KEY_LAYER_SHIFT + RENDER_KEY_LAYER_BITS == 64, "The fields of a sort key fill 64 bits");
+static_assert(render_layer_count <= (1 << RENDER_KEY_LAYER_BITS), "Every layer fits in the key");
+static_assert(effect_count <= (1 << RENDER_KEY_EFFECT_BITS), "Every effect fits in the key");
+
+static uint64_t KeyField(uint32_t value, int bits, int shift)
+{
+	return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+}
+
+void RenderQueue::Clear()
+{
+	keys.clear();
+	entities.clear();
+}
+
+void RenderQueue::Push(RENDER_LAYER layer, uint32_t depth, EFFECT_ASSET_ID effect, uint32_t texture, Entity entity)
+{
+	const uint32_t index = (uint32_t)entities.size();
+	assert(index < (1u << RENDER_KEY_INDEX_BITS) && "Too many submissions for the sort key");
+
+	switch (layer_orders[(int)layer])
+	{
+	case LAYER_ORDER::DEPTH:
+		depth = std::min(depth, MaxDepth());
+		break;
+	case LAYER_ORDER::SUBMISSION:
+		depth = index;
+		break;
+	case LAYER_ORDER::STATE:
+		depth = 0;
+		break;
+	}
+
+	keys.push_back(KeyField((uint32_t)layer, RENDER_KEY_LAYER_BITS, RENDER_KEY_LAYER_SHIFT) |
+		KeyField(depth, RENDER_KEY_DEPTH_BITS, RENDER_KEY_DEPTH_SHIFT) |
+		KeyField((uint32_t)effect, RENDER_KEY_EFFECT_BITS, RENDER_KEY_EFFECT_SHIFT) |
+		KeyField(texture, RENDER_KEY_TEXTURE_BITS, RENDER_KEY_TEXTURE_SHIFT) |
+		KeyField(index, RENDER_KEY_INDEX_BITS, RENDER_KEY_INDEX_SHIFT));
+	entities.push_back(entity);
+}
+
+void RenderQueue::Sort()
+{
+	if (keys.size() < 2)
+		return;
+
+	// the bytes that differ between the keys, the other passes would copy them in the same order
+	uint64_t differ = 0;
+	for (uint64_t key : keys)
+		differ |= key ^ keys[0];
+
+	scratch.resize(keys.size());
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		if (((differ >> shift) & 0xff) == 0)
+			continue;
+
+		// counting sort on one byte, stable so the lower bytes keep their order
+		size_t offsets[256] = {};
+		for (uint64_t key : keys)
+			offsets[(key >> shift) & 0xff]++;
+		size_t sum = 0;
+		for (size_t &offset : offsets)
+		{
+			size_t count = offset;
+			offset = sum;
+			sum += count;
+		}
+		for (uint64_t key : keys)
+			scratch[offsets[(key >> shift) & 0xff]++] = key;
+		keys.swap(scratch);
+	}
+}
+
+Entity RenderQueue::Get(size_t i) const
+{
+	return entities[keys[i] & ((1u << RENDER_KEY_INDEX_BITS) - 1)];
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "components.hpp"
+#include "tiny_ecs.hpp"
+
+// how the submissions of a layer are ordered
+enum class LAYER_ORDER {
+	DEPTH = 0, // by the depth given with them, the bottom of a sprite for the top-down view
+	SUBMISSION = DEPTH + 1, // in the order they were pushed, when they are stacked on purpose
+	STATE = SUBMISSION + 1 // by effect and texture only, for the fewest draw calls
+};
+
+const LAYER_ORDER layer_orders[render_layer_count] = {
+	LAYER_ORDER::SUBMISSION, // BACKGROUND
+	LAYER_ORDER::STATE, // GROUND
+	LAYER_ORDER::DEPTH, // ACTORS
+	LAYER_ORDER::STATE, // CROWD
+	LAYER_ORDER::STATE, // EFFECTS
+	LAYER_ORDER::SUBMISSION, // DEBUG
+	LAYER_ORDER::SUBMISSION // UI
+};
+
+// the bits of a sort key, from the highest: layer, depth, effect, texture, then the index of the
+// submission that makes every key unique and finds the entity back
+const int RENDER_KEY_LAYER_BITS = 4;
+const int RENDER_KEY_DEPTH_BITS = 24;
+const int RENDER_KEY_EFFECT_BITS = 4;
+const int RENDER_KEY_TEXTURE_BITS = 12;
+const int RENDER_KEY_INDEX_BITS = 20;
+
+/*
+* the entities to draw in a frame, sorted by a 64 bit key
+*
+* the key orders the layers first, then in a layer the depth (see layer_orders), then the effect and
+* the texture so that the sprites that can be drawn together follow each other. the keys are
+* sorted with a radix sort, 8 bits a pass, skipping the bytes that are the same in every key.
+*/
+class RenderQueue
+{
+public:
+	void Clear();
+
+	// depth is only used by the DEPTH layers, the others put their own order there. texture is the
+	// gl handle of the texture, or 0
+	void Push(RENDER_LAYER layer, uint32_t depth, EFFECT_ASSET_ID effect, uint32_t texture, Entity entity);
+
+	void Sort();
+
+	size_t Size() const { return keys.size(); }
+
+	// the i-th submission in the sorted order
+	Entity Get(size_t i) const;
+
+	// the largest depth a key can hold
+	static uint32_t MaxDepth() { return (1u << RENDER_KEY_DEPTH_BITS) - 1; }
+
+private:
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> scratch;
+	std::vector<Entity> entities; // in the order of the submissions
+};
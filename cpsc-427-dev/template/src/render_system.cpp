@@ -2,12 +2,18 @@
 #include "render_system.hpp"
 #include <SDL.h>
 #include <glm/gtx/matrix_transform_2d.hpp>
+#include <glm/matrix.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 
 #include "world_init.hpp"
 #include "tiny_ecs_registry.hpp"
 
-void RenderSystem::drawTexturedMesh(Entity entity,
-	const mat3 &projection)
+// the two triangles of a quad, as the sprite geometry
+static const uint16_t quad_indices[6] = { 0, 3, 1, 1, 3, 2 };
+
+void RenderSystem::drawTexturedMesh(Entity entity)
 {
 	Motion &motion = registry.motions.get(entity);
 	// Transformation code, see Rendering and Transformation in the template
@@ -26,148 +32,774 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 	const GLuint used_effect_enum = (GLuint)render_request.used_effect;
 	assert(used_effect_enum != (GLuint)EFFECT_ASSET_ID::EFFECT_COUNT);
 	const GLuint program = (GLuint)effects[used_effect_enum];
+	const EffectLocations &locations = effect_locations[used_effect_enum];
 
 	// Setting shaders
 	glUseProgram(program);
+	bindFrameUniforms(render_request.used_effect);
 	gl_has_errors();
 
 	assert(render_request.used_geometry != GEOMETRY_BUFFER_ID::GEOMETRY_COUNT);
-	const GLuint vbo = vertex_buffers[(GLuint)render_request.used_geometry];
-	const GLuint ibo = index_buffers[(GLuint)render_request.used_geometry];
 
-	// Setting vertex and index buffers
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	// the vertex and index buffers with the attributes of the effect
+	const GLuint vertex_array = vertex_arrays[(GLuint)render_request.used_geometry][used_effect_enum];
+	assert(vertex_array != 0 && "The effect doesn't read the vertices of this geometry");
+	glBindVertexArray(vertex_array);
 	gl_has_errors();
 
-	// Input data location as in the vertex buffer
 	if (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED ||
 		render_request.used_effect == EFFECT_ASSET_ID::UI)
 	{
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-		gl_has_errors();
-		assert(in_texcoord_loc >= 0);
-
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(TexturedVertex), (void *)0);
-		gl_has_errors();
-
-		glEnableVertexAttribArray(in_texcoord_loc);
-		glVertexAttribPointer(
-			in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex),
-			(void *)sizeof(
-				vec3)); // note the stride to skip the preceeding vertex position
-
 		// Enabling and binding texture to slot 0
 		glActiveTexture(GL_TEXTURE0);
 		gl_has_errors();
 
-		assert(registry.renderRequests.has(entity));
-		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
+		const GLuint texture = (GLuint)render_request.used_texture;
+		GLuint texture_id = texture_gl_handles[texture];
 
 		assert(texture_id != (int)TEXTURE_ASSET_ID::BUG);
 		glBindTexture(GL_TEXTURE_2D, texture_id);
 		gl_has_errors();
 
-		if (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED)
+		// the part of the atlas to show
+		assert(locations.uv_rect >= 0);
+		glUniform4fv(locations.uv_rect, 1, (float *)&texture_uv_rects[texture]);
+		gl_has_errors();
+	}
+	else if (render_request.used_effect != EFFECT_ASSET_ID::EGG)
+	{
+		assert(false && "Type of render request not supported");
+	}
+
+	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+	glUniform3fv(locations.fcolor, 1, (float *)&color);
+	gl_has_errors();
+
+	assert(locations.transform >= 0);
+	glUniformMatrix3fv(locations.transform, 1, GL_FALSE, (float *)&transform.mat);
+	gl_has_errors();
+
+	// Drawing of num_indices/3 triangles specified in the index buffer
+	glDrawElements(GL_TRIANGLES, index_counts[(GLuint)render_request.used_geometry], GL_UNSIGNED_SHORT, nullptr);
+	drawCallCount++;
+	gl_has_errors();
+}
+
+bool RenderSystem::updateMinimapLayout()
+{
+	if (registry.gameStates.size() == 0) // is in any level
+		return false;
+
+	auto &gameState = registry.gameStates.components[0];
+	if (gameState.AtValidLevel() == false)
+		return false;
+
+	const vec2 mapSize = gameState.GetMapPixelSize();
+	const float minimapWidth = window_width_px * MINIMAP_WIDTH_COEF;
+	const float scaleCoef = minimapWidth / mapSize.x;
+	const vec2 minimapPos = vec2(MINIMAP_POS_X, MINIMAP_POS_Y);
+
+	minimapView = mat3(1.0f);
+	minimapView = glm::translate(minimapView, minimapPos);
+	minimapView = glm::scale(minimapView, vec2(scaleCoef));
+
+	// the texture covers the map and the walls of its border, which stick out of it
+	const vec2 lo = vec2(-WALL_SIZE);
+	const vec2 hi = mapSize;
+	minimapCacheSize = (hi - lo) * scaleCoef;
+	minimapCacheCenter = minimapPos + (lo + hi) / 2.0f * scaleCoef;
+	minimapCacheView = glm::translate(glm::scale(mat3(1.0f), vec2(scaleCoef)), -lo);
+
+	// as createProjectionMatrix() over the texture, upside down: the first row of a texture is
+	// its bottom, the sprites show it at the top
+	const vec2 size = minimapCacheSize;
+	minimapCacheProjection = { { 2.f / size.x, 0.f, 0.f }, { 0.f, 2.f / size.y, 0.f }, { -1.f, -1.f, 1.f } };
+
+	// a new level, or a new size of the window
+	int w, h;
+	glfwGetFramebufferSize(window, &w, &h);
+	const ivec2 pixels = ivec2(glm::ceil(minimapCacheSize * (float)w / (float)window_width_px));
+	if (pixels != minimapTextureSize || mapSize != minimapMapSize)
+	{
+		minimapTextureSize = pixels;
+		minimapMapSize = mapSize;
+		glBindTexture(GL_TEXTURE_2D, minimap_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pixels.x, pixels.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		gl_has_errors();
+		minimapDirty = true;
+	}
+	return true;
+}
+
+void RenderSystem::renderMinimapCache()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, minimap_frame_buffer);
+	glViewport(0, 0, minimapTextureSize.x, minimapTextureSize.y);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// the texture keeps the colors multiplied by their alpha, and the alpha covered
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+	gl_has_errors();
+
+	setFramePass(FRAME_PASS::MINIMAP_CACHE);
+
+	// draw a temperary background and remove it
+	{
+		vec2 bgCenter = minimapMapSize / 2.0f - vec2(WALL_SIZE);
+		vec2 bgSize = minimapMapSize - vec2(WALL_SIZE);
+		auto bgEntity = createBackground(this, bgCenter, bgSize, TEXTURE_ASSET_ID::FLOOR_BG);
+		batchEntity(bgEntity);
+		registry.remove_all_components_of(bgEntity);
+	}
+	flushSprites();
+	drawStaticLayer(true);
+
+	minimapDirty = false;
+}
+
+void RenderSystem::updateFrameUniforms(const mat3 &projection, bool hasMinimap)
+{
+	frameUniformData.assign((size_t)frame_uniforms_stride * frame_pass_count, 0);
+	for (int pass = 0; pass < frame_pass_count; pass++)
+	{
+		FrameUniforms uniforms = {};
+		mat3 view = mat3(1.0f);
+		mat3 pass_projection = projection;
+		if (pass == (int)FRAME_PASS::WORLD)
 		{
-			GLint translation_loc = glGetUniformLocation(program, "view");
-			assert(translation_loc >= 0);
-			glUniformMatrix3fv(translation_loc, 1, GL_FALSE, (float *)&viewMatrix);
-			gl_has_errors();
+			view = viewMatrix;
+			uniforms.useMask = useMask;
+		}
+		else if (pass == (int)FRAME_PASS::MINIMAP && hasMinimap)
+		{
+			view = minimapView; // minimap not use the mask
+		}
+		else if (pass == (int)FRAME_PASS::MINIMAP_CACHE && hasMinimap)
+		{
+			view = minimapCacheView;
+			pass_projection = minimapCacheProjection;
+		}
 
-				GLint loc;
-				loc = glGetUniformLocation(program, "useMask");
-				assert(loc >= 0);
-				glUniform1i(loc, useMask);
-				gl_has_errors();
+		for (int c = 0; c < 3; c++)
+		{
+			uniforms.projection[c] = vec4(pass_projection[c], 0.f);
+			uniforms.view[c] = vec4(view[c], 0.f);
+		}
+		uniforms.playerPos = playerPos;
+		uniforms.rBright = window_height_px / 2.0f * 0.9f;
+		uniforms.rDark = window_height_px / 2.0f * 1.2f;
+		memcpy(&frameUniformData[(size_t)frame_uniforms_stride * pass], &uniforms, sizeof(uniforms));
+	}
+
+	frame_uniforms_offset = uniform_stream.Write(frameUniformData.data(), frameUniformData.size(), uniform_alignment);
+	boundFramePass = -1;
+}
 
-			// use mask
-			if (useMask)
+void RenderSystem::setFramePass(FRAME_PASS pass)
+{
+	framePass = pass;
+}
+
+void RenderSystem::bindFrameUniforms(EFFECT_ASSET_ID effect)
+{
+	// the ui effects are placed on the screen in every pass
+	const int pass = (int)(effect == EFFECT_ASSET_ID::UI ? FRAME_PASS::SCREEN : framePass);
+	if (pass == boundFramePass)
+		return;
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, uniform_stream.GetBuffer(),
+		frame_uniforms_offset + (GLintptr)frame_uniforms_stride * pass, sizeof(FrameUniforms));
+	gl_has_errors();
+	boundFramePass = pass;
+}
+
+// draw all the sprites of a batch with one instanced draw call
+void RenderSystem::drawSpriteBatch(Entity entity)
+{
+	const SpriteBatch &batch = registry.spriteBatches.get(entity);
+	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+	const vec4 uv_rect = texture_uv_rects[(GLuint)batch.texture];
+
+	// only the sprites on the screen
+	batchSprites.clear();
+	for (const vec2 &position : batch.positions)
+	{
+		if (isInView(position, batch.scale, 0.f))
+			batchSprites.push_back({ position, batch.scale, 0.f, uv_rect, color });
+	}
+	visibleCount += (int)batchSprites.size();
+	culledCount += (int)(batch.positions.size() - batchSprites.size());
+	drawInstances(EFFECT_ASSET_ID::TEXTURED, texture_gl_handles[(GLuint)batch.texture], batchSprites);
+}
+
+void RenderSystem::updateParticleBuffers()
+{
+	// the batches that are gone
+	for (size_t i = 0; i < particleBuffers.size();)
+	{
+		ParticleBuffer &particles = particleBuffers[i];
+		if (registry.particleBatches.has(particles.entity))
+		{
+			i++;
+			continue;
+		}
+		glDeleteBuffers(1, &particles.buffer);
+		glDeleteVertexArrays(1, &particles.vertex_array);
+		particles = particleBuffers.back();
+		particleBuffers.pop_back();
+	}
+
+	for (Entity &entity : registry.particleBatches.entities)
+	{
+		ParticleBatch &batch = registry.particleBatches.get(entity);
+		auto found = std::find_if(particleBuffers.begin(), particleBuffers.end(), [&](ParticleBuffer &particles) { return particles.entity == entity; });
+		if (found == particleBuffers.end())
+		{
+			// the sprite geometry, then the particles once per instance, 4 floats at a time:
+			// (location, offset)
+			ParticleBuffer particles = { entity, 0, 0, 0 };
+			glGenBuffers(1, &particles.buffer);
+			glGenVertexArrays(1, &particles.vertex_array);
+			glBindVertexArray(particles.vertex_array);
+
+			const EffectLocations &locations = effect_locations[(GLuint)EFFECT_ASSET_ID::PARTICLE];
+			const GLsizei stride = vertex_strides[(GLuint)GEOMETRY_BUFFER_ID::SPRITE];
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE]);
+			glEnableVertexAttribArray(locations.in_position);
+			glVertexAttribPointer(locations.in_position, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+			glEnableVertexAttribArray(locations.in_texcoord);
+			glVertexAttribPointer(locations.in_texcoord, 2, GL_FLOAT, GL_FALSE, stride, (void *)sizeof(vec3));
+
+			const std::array<std::pair<GLint, size_t>, 4> instance_attributes = { {
+				{ locations.in_motion, offsetof(Particle, origin) },
+				{ locations.in_wave, offsetof(Particle, wave) },
+				{ locations.in_shape, offsetof(Particle, size) },
+				{ locations.in_life, offsetof(Particle, birth) } } };
+			glBindBuffer(GL_ARRAY_BUFFER, particles.buffer);
+			for (const auto &attribute : instance_attributes)
 			{
-				// player pos
-				loc = glGetUniformLocation(program, "playerPos");
-				assert(loc >= 0);
-				glUniform2f(loc, playerPos.x, playerPos.y);
-				gl_has_errors();
-
-
-				// rBright and rDark
-				loc = glGetUniformLocation(program, "rBright");
-				assert(loc >= 0);
-				glUniform1f(loc, window_height_px/2.0f * 0.9f);
-				gl_has_errors();
-				loc = glGetUniformLocation(program, "rDark");
-				assert(loc >= 0);
-				glUniform1f(loc, window_height_px / 2.0f * 1.2f);
-				gl_has_errors();
+				assert(attribute.first >= 0);
+				glEnableVertexAttribArray(attribute.first);
+				glVertexAttribPointer(attribute.first, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)attribute.second);
+				glVertexAttribDivisor(attribute.first, 1);
 			}
+			glBindVertexArray(default_vertex_array);
+			gl_has_errors();
+
+			particleBuffers.push_back(particles);
+			found = particleBuffers.end() - 1;
+			batch.dirty = true;
 		}
 
+		// only when particles were added, they move in the shader
+		if (!batch.dirty)
+			continue;
+		glBindBuffer(GL_ARRAY_BUFFER, found->buffer);
+		glBufferData(GL_ARRAY_BUFFER, batch.particles.size() * sizeof(Particle), batch.particles.data(), GL_STATIC_DRAW);
+		gl_has_errors();
+		found->count = (GLsizei)batch.particles.size();
+		batch.dirty = false;
 	}
-	else if (render_request.used_effect == EFFECT_ASSET_ID::EGG)
+}
+
+// draw all the particles of a batch with one instanced draw call
+void RenderSystem::drawParticleBatch(Entity entity)
+{
+	const ParticleBatch &batch = registry.particleBatches.get(entity);
+	auto found = std::find_if(particleBuffers.begin(), particleBuffers.end(), [&](ParticleBuffer &particles) { return particles.entity == entity; });
+	if (found == particleBuffers.end() || found->count == 0)
+		return;
+
+	const GLuint effect = (GLuint)EFFECT_ASSET_ID::PARTICLE;
+	glUseProgram(effects[effect]);
+	bindFrameUniforms(EFFECT_ASSET_ID::PARTICLE);
+	glUniform1f(effect_locations[effect].time, (float)glfwGetTime());
+	glUniform4fv(effect_locations[effect].uv_rect, 1, (float *)&texture_uv_rects[(GLuint)batch.texture]);
+	gl_has_errors();
+
+	glBindVertexArray(found->vertex_array);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture_gl_handles[(GLuint)batch.texture]);
+	gl_has_errors();
+
+	glDrawElementsInstanced(GL_TRIANGLES, index_counts[(GLuint)GEOMETRY_BUFFER_ID::SPRITE], GL_UNSIGNED_SHORT, nullptr, found->count);
+	drawCallCount++;
+	gl_has_errors();
+}
+
+void RenderSystem::batchEntity(Entity entity)
+{
+	const RenderRequest &render_request = registry.renderRequests.get(entity);
+
+	// the instanced shader only does textured sprites
+	bool batchable = render_request.used_geometry == GEOMETRY_BUFFER_ID::SPRITE &&
+		(render_request.used_effect == EFFECT_ASSET_ID::TEXTURED || render_request.used_effect == EFFECT_ASSET_ID::UI);
+	if (!batchable)
 	{
-		GLint in_position_loc = glGetAttribLocation(program, "in_position");
-		GLint in_color_loc = glGetAttribLocation(program, "in_color");
-		gl_has_errors();
+		flushSprites();
+		drawTexturedMesh(entity);
+		return;
+	}
 
-		glEnableVertexAttribArray(in_position_loc);
-		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(ColoredVertex), (void *)0);
-		gl_has_errors();
+	const GLuint texture = (GLuint)render_request.used_texture;
+	if (!pendingSprites.empty() && (render_request.used_effect != pendingEffect || texture_gl_handles[texture] != pendingTexture))
+		flushSprites();
 
-		glEnableVertexAttribArray(in_color_loc);
-		glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE,
-			sizeof(ColoredVertex), (void *)sizeof(vec3));
-		gl_has_errors();
+	pendingEffect = render_request.used_effect;
+	pendingTexture = texture_gl_handles[texture];
+
+	const Motion &motion = registry.motions.get(entity);
+	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+	pendingSprites.push_back({ motion.position, motion.scale, motion.angle, texture_uv_rects[texture], color });
+}
+
+void RenderSystem::flushSprites()
+{
+	if (pendingSprites.empty())
+		return;
+
+	drawInstances(pendingEffect, pendingTexture, pendingSprites);
+	pendingSprites.clear();
+}
+
+void RenderSystem::drawInstances(EFFECT_ASSET_ID effect, GLuint texture, const std::vector<SpriteInstance> &instances)
+{
+	if (instances.empty())
+		return;
+
+	const GLuint program = effects[(GLuint)EFFECT_ASSET_ID::SPRITE_BATCH];
+	glUseProgram(program);
+	bindFrameUniforms(effect);
+	gl_has_errors();
+
+	// the sprite geometry and the instance attributes
+	glBindVertexArray(vertex_arrays[(GLuint)GEOMETRY_BUFFER_ID::SPRITE][(GLuint)EFFECT_ASSET_ID::SPRITE_BATCH]);
+	gl_has_errors();
+
+	// the sprites, after the ones of the last draws of the frame
+	GLintptr offset = instance_stream.Write(instances.data(), instances.size() * sizeof(SpriteInstance));
+	pointInstanceAttributes(offset);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	gl_has_errors();
+
+	glDrawElementsInstanced(GL_TRIANGLES, index_counts[(GLuint)GEOMETRY_BUFFER_ID::SPRITE], GL_UNSIGNED_SHORT, nullptr, (GLsizei)instances.size());
+	drawCallCount++;
+	gl_has_errors();
+}
+
+void RenderSystem::loadTextureGroup(TEXTURE_GROUP group_id)
+{
+	TextureGroup &group = texture_group_states[(int)group_id];
+	group.loaded = true;
+	group.unusedFrames = 0;
+
+	// the pages are filled as their images arrive, the gaps between them are never sampled
+	group.pages.resize(group.pageSizes.size());
+	glGenTextures((GLsizei)group.pages.size(), group.pages.data());
+	for (size_t page = 0; page < group.pages.size(); page++)
+	{
+		glBindTexture(GL_TEXTURE_2D, group.pages[page]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, group.pageSizes[page], group.pageSizes[page], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	gl_has_errors();
+
+	for (uint i : group.textures)
+	{
+		texture_states[i] = TEXTURE_STATE::LOADING;
+		texture_jobs.push_back(i);
+	}
+}
+
+void RenderSystem::evictTextureGroup(TEXTURE_GROUP group_id)
+{
+	TextureGroup &group = texture_group_states[(int)group_id];
+	if (!group.loaded)
+		return;
 
-		//GLint currProgram;
-		//glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
-		//// Setting uniform values to the currently bound program 
-		//GLuint transform_loc = glGetUniformLocation(currProgram, "transform");
-		//glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float*)&transform.mat);
-		//GLuint projection_loc = glGetUniformLocation(currProgram, "projection");
-		//glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float*)&projection);
-		//gl_has_errors();
+	// the images still on their way are dropped when they arrive
+	for (uint i : group.textures)
+	{
+		texture_states[i] = TEXTURE_STATE::EVICTED;
+		texture_gl_handles[i] = placeholder_texture;
+		texture_uv_rects[i] = vec4(0, 0, 1, 1);
+		if (texture_own_handles[i] != 0)
+			glDeleteTextures(1, &texture_own_handles[i]);
+		texture_own_handles[i] = 0;
+	}
+	texture_jobs.erase(std::remove_if(texture_jobs.begin(), texture_jobs.end(), [&](uint i) {
+		return texture_states[i] == TEXTURE_STATE::EVICTED;
+	}), texture_jobs.end());
+
+	glDeleteTextures((GLsizei)group.pages.size(), group.pages.data());
+	group.pages.clear();
+	group.loaded = false;
+
+	// the image being uploaded may be one of them, the next one starts over
+	texture_upload_row = 0;
+	gl_has_errors();
+}
+
+bool RenderSystem::uploadTextureSlice(TextureResult &result, size_t &budget)
+{
+	const uint i = (uint)result.texture;
+	const int page = texture_page_indices[i];
+	const size_t row_size = (size_t)result.size.x * 4;
+	const int rows = std::min(result.size.y - texture_upload_row, std::max(1, (int)(budget / row_size)));
+
+	// a big image gets its own texture with the first rows
+	GLuint texture;
+	ivec2 pos(0, 0);
+	if (page >= 0)
+	{
+		texture = texture_group_states[(int)get_texture_group((TEXTURE_ASSET_ID)i)].pages[page];
+		pos = texture_positions[i];
 	}
 	else
 	{
-		assert(false && "Type of render request not supported");
+		if (texture_own_handles[i] == 0)
+		{
+			glGenTextures(1, &texture_own_handles[i]);
+			glBindTexture(GL_TEXTURE_2D, texture_own_handles[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, result.size.x, result.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		}
+		texture = texture_own_handles[i];
 	}
 
-	// Getting uniform locations for glUniform* calls
-	GLint color_uloc = glGetUniformLocation(program, "fcolor");
-	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
-	glUniform3fv(color_uloc, 1, (float *)&color);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y + texture_upload_row, result.size.x, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+		result.pixels.data() + texture_upload_row * row_size);
 	gl_has_errors();
+	texture_upload_row += rows;
+	budget -= std::min(budget, rows * row_size);
+	if (texture_upload_row < result.size.y)
+		return false;
+
+	// drawn from now on
+	texture_gl_handles[i] = texture;
+	if (page >= 0)
+	{
+		const float page_size = (float)texture_group_states[(int)get_texture_group((TEXTURE_ASSET_ID)i)].pageSizes[page];
+		const vec2 corner = vec2(pos + ATLAS_BORDER) / page_size;
+		texture_uv_rects[i] = vec4(corner, corner + vec2(texture_dimensions[i]) / page_size);
+	}
+	texture_states[i] = TEXTURE_STATE::RESIDENT;
+	return true;
+}
+
+void RenderSystem::updateTextureStreaming()
+{
+	// the groups of the textures that are drawn
+	std::array<bool, texture_group_count> used = {};
+	auto use = [&](TEXTURE_ASSET_ID texture) {
+		if (texture != TEXTURE_ASSET_ID::TEXTURE_COUNT)
+			used[(int)get_texture_group(texture)] = true;
+	};
+	for (const RenderRequest &render_request : registry.renderRequests.components)
+		use(render_request.used_texture);
+	for (const SpriteBatch &batch : registry.spriteBatches.components)
+		use(batch.texture);
+	for (const ParticleBatch &batch : registry.particleBatches.components)
+		use(batch.texture);
+
+	for (int g = 0; g < texture_group_count; g++)
+	{
+		TextureGroup &group = texture_group_states[g];
+		if (used[g] && !group.loaded)
+			loadTextureGroup((TEXTURE_GROUP)g);
+		group.unusedFrames = used[g] ? 0 : group.unusedFrames + 1;
+		if (group.unusedFrames >= TEXTURE_EVICT_FRAMES)
+			evictTextureGroup((TEXTURE_GROUP)g);
+	}
+
+	// the images that fit in the loader queue
+	size_t submitted = 0;
+	while (submitted < texture_jobs.size())
+	{
+		const uint i = texture_jobs[submitted];
+		if (!texture_loader.Submit((int)i, texture_paths[i], texture_page_indices[i] >= 0 ? ATLAS_BORDER : 0))
+			break;
+		submitted++;
+	}
+	texture_jobs.erase(texture_jobs.begin(), texture_jobs.begin() + submitted);
+
+	// the decoded images, a slice of them every frame
+	bool uploaded = false;
+	size_t budget = TEXTURE_UPLOAD_BUDGET;
+	while (budget > 0)
+	{
+		TextureResult *result = texture_loader.PeekResult();
+		if (result == nullptr)
+			break;
+
+		// evicted or loaded again since it was submitted, or not decoded
+		if (texture_states[result->texture] == TEXTURE_STATE::LOADING && result->loaded)
+		{
+			if (!uploadTextureSlice(*result, budget))
+				break;
+			uploaded = true;
+		}
+		// the slot would keep the decoded copy until it is used again
+		std::vector<uint8_t>().swap(result->pixels);
+		texture_upload_row = 0;
+		texture_loader.PopResult();
+	}
+
+	// the static layer has the uv rects in its vertices
+	if (uploaded && staticLiveCount > 0)
+		bakeStaticLayer();
+}
 
-	// Get number of indices from index buffer, which has elements uint16_t
-	GLint size = 0;
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+void RenderSystem::bakeStaticLayer()
+{
+	auto &statics = registry.staticSprites;
+
+	staticRuns.clear();
+	staticEntities = statics.entities;
+	staticVertices.resize(statics.size() * 4);
+	staticGridQuads.clear();
+	staticLargeQuads.clear();
+	staticCenterX.clear();
+	staticCenterY.clear();
+	staticMaxHalfExtent = 0;
+
+	// every quad, then room for the quads on the screen (cullStaticLayer)
+	std::vector<uint32_t> indices(statics.size() * 6 * 2);
+
+	for (size_t i = 0; i < staticEntities.size(); i++)
+	{
+		Entity entity = staticEntities[i];
+		const Motion &motion = registry.motions.get(entity);
+		const RenderRequest &render_request = registry.renderRequests.get(entity);
+		assert(render_request.used_geometry == GEOMETRY_BUFFER_ID::SPRITE);
+
+		Transform transform;
+		transform.translate(motion.position);
+		transform.scale(motion.scale);
+		transform.rotate(motion.angle);
+
+		// a quad bigger than a cell (the floor) would grow the query of every frame to most of the
+		// grid, it is tested on its own
+		const float half_extent = glm::length(motion.scale) * 0.5f;
+		if (half_extent > STATIC_GRID_CELL_SIZE)
+			staticLargeQuads.push_back((int)i);
+		else
+		{
+			staticGridQuads.push_back((int)i);
+			staticCenterX.push_back(motion.position.x);
+			staticCenterY.push_back(motion.position.y);
+			staticMaxHalfExtent = glm::max(staticMaxHalfExtent, half_extent);
+		}
+
+		// the corners of the sprite geometry, in the world and in the atlas
+		const GLuint texture = (GLuint)render_request.used_texture;
+		const vec4 uv_rect = texture_uv_rects[texture];
+		const vec2 corners[4] = { { -0.5f, 0.5f }, { 0.5f, 0.5f }, { 0.5f, -0.5f }, { -0.5f, -0.5f } };
+		for (int k = 0; k < 4; k++)
+		{
+			TexturedVertex &vertex = staticVertices[i * 4 + k];
+			vertex.position = vec3(vec2(transform.mat * vec3(corners[k], 1.f)), 0.f);
+			vertex.texcoord = mix(vec2(uv_rect.x, uv_rect.y), vec2(uv_rect.z, uv_rect.w), corners[k] + 0.5f);
+		}
+		for (int k = 0; k < 6; k++)
+			indices[i * 6 + k] = (uint32_t)(i * 4 + quad_indices[k]);
+
+		const GLuint texture_id = texture_gl_handles[texture];
+		if (staticRuns.empty() || staticRuns.back().texture != texture_id || staticRuns.back().showOnMinimap != render_request.showOnMinimap)
+			staticRuns.push_back({ texture_id, (GLsizei)(i * 6), 0, render_request.showOnMinimap });
+		staticRuns.back().count += 6;
+	}
+
+	bindVBOandIBO(GEOMETRY_BUFFER_ID::STATIC_LAYER, staticVertices, indices);
+	staticLiveCount = staticEntities.size();
+	minimapDirty = true;
+
+	// the grid over the centers, the quads are found from the view rect grown by the biggest one
+	if (staticGridQuads.empty())
+		return;
+	const vec2 lo(*std::min_element(staticCenterX.begin(), staticCenterX.end()), *std::min_element(staticCenterY.begin(), staticCenterY.end()));
+	const vec2 hi(*std::max_element(staticCenterX.begin(), staticCenterX.end()), *std::max_element(staticCenterY.begin(), staticCenterY.end()));
+	staticGrid.Init(lo, STATIC_GRID_CELL_SIZE, (int)((hi.x - lo.x) / STATIC_GRID_CELL_SIZE) + 1, (int)((hi.y - lo.y) / STATIC_GRID_CELL_SIZE) + 1);
+	staticGrid.Build(staticCenterX.data(), staticCenterY.data(), (int)staticGridQuads.size());
+}
+
+void RenderSystem::updateStaticLayer()
+{
+	if (registry.staticSprites.size() == staticLiveCount)
+		return;
+
+	// the level was left
+	if (registry.staticSprites.size() == 0)
+	{
+		staticRuns.clear();
+		staticEntities.clear();
+		staticLiveCount = 0;
+		minimapDirty = true;
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::STATIC_LAYER]);
+	for (size_t i = 0; i < staticEntities.size(); i++)
+	{
+		if (registry.staticSprites.has(staticEntities[i]))
+			continue;
+
+		// all the corners at one point, the quad is not drawn any more
+		TexturedVertex *quad = &staticVertices[i * 4];
+		if (quad[0].position == quad[2].position)
+			continue;
+		for (int k = 1; k < 4; k++)
+			quad[k].position = quad[0].position;
+		glBufferSubData(GL_ARRAY_BUFFER, i * 4 * sizeof(TexturedVertex), 4 * sizeof(TexturedVertex), quad);
+		staticLiveCount--;
+		minimapDirty = true;
+	}
 	gl_has_errors();
 
-	GLsizei num_indices = size / sizeof(uint16_t);
-	// GLsizei num_triangles = num_indices / 3;
+	// new static sprites, baked again
+	if (registry.staticSprites.size() != staticLiveCount)
+		bakeStaticLayer();
+}
 
-	GLint currProgram;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
-	assert(currProgram >= 0);
+void RenderSystem::cullStaticLayer()
+{
+	staticVisibleRuns.clear();
+	if (staticLiveCount == 0)
+		return;
 
-	// Setting uniform values to the currently bound program
-	GLint transform_loc = glGetUniformLocation(currProgram, "transform");
-	assert(transform_loc >= 0);
-	glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float *)&transform.mat);
+	// the quads near the screen, in the order of the layer (the draw order)
+	staticVisibleQuads = staticLargeQuads;
+	if (!staticGridQuads.empty())
+	{
+		staticGrid.QueryRect(viewMin - staticMaxHalfExtent, viewMax + staticMaxHalfExtent, [this](int item) {
+			staticVisibleQuads.push_back(staticGridQuads[item]);
+		});
+	}
+	std::sort(staticVisibleQuads.begin(), staticVisibleQuads.end());
 
-	GLint projection_loc = glGetUniformLocation(currProgram, "projection");
-	assert(projection_loc >= 0);
-	glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
+	const GLsizei first_visible = (GLsizei)staticEntities.size() * 6;
+	staticVisibleIndices.clear();
+	size_t run = 0;
+	int visible_run = -1;
+	for (int quad : staticVisibleQuads)
+	{
+		// removed, or not on the screen
+		const TexturedVertex *corners = &staticVertices[quad * 4];
+		if (corners[0].position == corners[2].position)
+			continue;
+		vec2 lo = vec2(corners[0].position);
+		vec2 hi = lo;
+		for (int k = 1; k < 4; k++)
+		{
+			lo = glm::min(lo, vec2(corners[k].position));
+			hi = glm::max(hi, vec2(corners[k].position));
+		}
+		if (hi.x < viewMin.x || lo.x > viewMax.x || hi.y < viewMin.y || lo.y > viewMax.y)
+			continue;
 
+		// the quads keep the runs of the layer
+		while (staticRuns[run].first + staticRuns[run].count <= quad * 6)
+			run++;
+		if (visible_run != (int)run)
+		{
+			const StaticRun &layer_run = staticRuns[run];
+			staticVisibleRuns.push_back({ layer_run.texture, first_visible + (GLsizei)staticVisibleIndices.size(), 0, layer_run.showOnMinimap });
+			visible_run = (int)run;
+		}
+		for (int k = 0; k < 6; k++)
+			staticVisibleIndices.push_back((uint32_t)(quad * 4 + quad_indices[k]));
+		staticVisibleRuns.back().count += 6;
+	}
+
+	const int visible = (int)staticVisibleIndices.size() / 6;
+	visibleCount += visible;
+	culledCount += (int)staticLiveCount - visible;
+	if (visible == 0)
+		return;
+
+	// after the indices of every quad
+	glBindVertexArray(vertex_arrays[(GLuint)GEOMETRY_BUFFER_ID::STATIC_LAYER][(GLuint)EFFECT_ASSET_ID::TEXTURED]);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first_visible * sizeof(uint32_t),
+		staticVisibleIndices.size() * sizeof(uint32_t), staticVisibleIndices.data());
 	gl_has_errors();
-	// Drawing of num_indices/3 triangles specified in the index buffer
-	glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+}
+
+void RenderSystem::updateViewRect()
+{
+	// the corners of the screen, back in the world
+	const mat3 inverse_view = glm::inverse(viewMatrix);
+	const vec2 corners[4] = { { 0.f, 0.f }, { window_width_px, 0.f }, { 0.f, window_height_px }, { window_width_px, window_height_px } };
+	viewMin = vec2(FLT_MAX);
+	viewMax = vec2(-FLT_MAX);
+	for (const vec2 &corner : corners)
+	{
+		const vec2 world = vec2(inverse_view * vec3(corner, 1.f));
+		viewMin = glm::min(viewMin, world);
+		viewMax = glm::max(viewMax, world);
+	}
+}
+
+uint32_t RenderSystem::depthOf(const Motion &motion) const
+{
+	float bottom = motion.position.y + abs(motion.scale.y) * 0.5f;
+	float depth = (bottom - viewMin.y + RENDER_DEPTH_MARGIN) * RENDER_DEPTH_STEPS;
+	return (uint32_t)glm::clamp(depth, 0.f, (float)RenderQueue::MaxDepth());
+}
+
+bool RenderSystem::isInView(vec2 position, vec2 scale, float angle) const
+{
+	// the box of the sprite, or of every rotation of it
+	vec2 half = glm::abs(scale) * 0.5f;
+	if (angle != 0.f)
+		half = vec2(glm::length(scale) * 0.5f);
+
+	return position.x + half.x >= viewMin.x && position.x - half.x <= viewMax.x &&
+		position.y + half.y >= viewMin.y && position.y - half.y <= viewMax.y;
+}
+
+void RenderSystem::drawStaticLayer(bool minimap)
+{
+	if (staticLiveCount == 0)
+		return;
+
+	const GLuint program = effects[(GLuint)EFFECT_ASSET_ID::TEXTURED];
+	const EffectLocations &locations = effect_locations[(GLuint)EFFECT_ASSET_ID::TEXTURED];
+	glUseProgram(program);
+	bindFrameUniforms(EFFECT_ASSET_ID::TEXTURED);
+	glBindVertexArray(vertex_arrays[(GLuint)GEOMETRY_BUFFER_ID::STATIC_LAYER][(GLuint)EFFECT_ASSET_ID::TEXTURED]);
+	gl_has_errors();
+
+	// the vertices are already in the world and in the atlas
+	const mat3 identity = mat3(1.0f);
+	const vec3 color = vec3(1);
+	const vec4 whole_texture = vec4(0, 0, 1, 1);
+	glUniformMatrix3fv(locations.transform, 1, GL_FALSE, (float *)&identity);
+	glUniform3fv(locations.fcolor, 1, (float *)&color);
+	glUniform4fv(locations.uv_rect, 1, (float *)&whole_texture);
+	glActiveTexture(GL_TEXTURE0);
+	gl_has_errors();
+
+	// the world pass only draws the quads on the screen
+	for (const StaticRun &run : minimap ? staticRuns : staticVisibleRuns)
+	{
+		if (minimap && !run.showOnMinimap)
+			continue;
+
+		glBindTexture(GL_TEXTURE_2D, run.texture);
+		glDrawElements(GL_TRIANGLES, run.count, GL_UNSIGNED_INT, (void *)(run.first * sizeof(uint32_t)));
+		drawCallCount++;
+	}
 	gl_has_errors();
 }
 
@@ -194,26 +826,14 @@ void RenderSystem::drawToScreen()
 	// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDisable(GL_DEPTH_TEST);
 
-	// Draw the screen texture on the quad geometry
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
-	glBindBuffer(
-		GL_ELEMENT_ARRAY_BUFFER,
-		index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]); // Note, GL_ELEMENT_ARRAY_BUFFER associates
-																	 // indices to the bound GL_ARRAY_BUFFER
+	// Draw the screen texture on the quad geometry, the vertex array has the vertex and index buffers
+	glBindVertexArray(vertex_arrays[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE][(GLuint)EFFECT_ASSET_ID::WIND]);
 	gl_has_errors();
-	const GLuint wind_program = effects[(GLuint)EFFECT_ASSET_ID::WIND];
+	const EffectLocations &wind_locations = effect_locations[(GLuint)EFFECT_ASSET_ID::WIND];
 	// Set clock
-	GLuint time_uloc = glGetUniformLocation(wind_program, "time");
-	GLuint dead_timer_uloc = glGetUniformLocation(wind_program, "darken_screen_factor");
-	glUniform1f(time_uloc, (float)(glfwGetTime() * 10.0f));
+	glUniform1f(wind_locations.time, (float)(glfwGetTime() * 10.0f));
 	ScreenState &screen = registry.screenStates.get(screen_state_entity);
-	glUniform1f(dead_timer_uloc, screen.darken_screen_factor);
-	gl_has_errors();
-	// Set the vertex position and vertex texture coordinates (both stored in the
-	// same VBO)
-	GLint in_position_loc = glGetAttribLocation(wind_program, "in_position");
-	glEnableVertexAttribArray(in_position_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+	glUniform1f(wind_locations.darken_screen_factor, screen.darken_screen_factor);
 	gl_has_errors();
 
 	// Bind our texture in Texture Unit 0
@@ -226,6 +846,7 @@ void RenderSystem::drawToScreen()
 		GL_TRIANGLES, 3, GL_UNSIGNED_SHORT,
 		nullptr); // one triangle = 3 vertices; nullptr indicates that there is
 				  // no offset from the bound index buffer
+	drawCallCount++;
 	gl_has_errors();
 }
 
@@ -237,6 +858,27 @@ void RenderSystem::draw()
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
 
+	drawCallCount = 0;
+	visibleCount = 0;
+	culledCount = 0;
+
+	// the regions of the streams the gpu is done with
+	instance_stream.BeginFrame();
+	uniform_stream.BeginFrame();
+
+	// the uniforms of every pass of the frame, in one upload
+	const bool hasMinimap = updateMinimapLayout();
+	updateFrameUniforms(createProjectionMatrix(), hasMinimap);
+
+	// the textures of the frame, the ones not uploaded yet are drawn with the placeholder
+	updateTextureStreaming();
+
+	// the static part of the minimap, when the walls changed
+	updateStaticLayer();
+	updateParticleBuffers();
+	if (hasMinimap && minimapDirty)
+		renderMinimapCache();
+
 	// First render to the custom framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
 	gl_has_errors();
@@ -253,92 +895,116 @@ void RenderSystem::draw()
 							  // and alpha blending, one would have to sort
 							  // sprites back to front
 	gl_has_errors();
-	mat3 projection_2D = createProjectionMatrix();
+	setFramePass(FRAME_PASS::WORLD);
 
-	std::vector<Entity> entitiesDrawFinal;
+	// the floor and the walls first, the ones on the screen
+	updateViewRect();
+	cullStaticLayer();
+	drawStaticLayer(false);
 
-	// Draw all textured meshes that have a position and size component
+	// the entities on the screen and the crowds, in one queue
+	renderQueue.Clear();
 	for (Entity &entity : registry.renderRequests.entities)
 	{
 		if (!registry.motions.has(entity)) // not motions
 			continue;
 
-		// mark the elements that should be drawn on the top layer
+		// drawn with the static layer
+		if (registry.staticSprites.has(entity))
+			continue;
+
+		const RenderRequest &render_request = registry.renderRequests.get(entity);
+		const Motion &motion = registry.motions.get(entity);
+
+		const GLuint texture = render_request.used_texture == TEXTURE_ASSET_ID::TEXTURE_COUNT ? 0 : texture_gl_handles[(GLuint)render_request.used_texture];
+
+		// the ui is always on top, and on the screen
 		if (registry.uis.has(entity))
 		{
-			entitiesDrawFinal.push_back(entity);
+			renderQueue.Push(RENDER_LAYER::UI, 0, render_request.used_effect, texture, entity);
 			continue;
 		}
 
-		// Note, its not very efficient to access elements indirectly via the entity
-		// albeit iterating through all Sprites in sequence. A good point to optimize
-		drawTexturedMesh(entity, projection_2D);
-	}
+		// off the screen. the other effects don't use the view
+		if (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED && !isInView(motion.position, motion.scale, motion.angle))
+		{
+			culledCount++;
+			continue;
+		}
+		visibleCount++;
 
-	// draw the elments on the top layer
-	for (Entity &entity : entitiesDrawFinal)
+		renderQueue.Push(render_request.layer, depthOf(motion), render_request.used_effect, texture, entity);
+	}
+	for (Entity &entity : registry.spriteBatches.entities)
 	{
-		drawTexturedMesh(entity, projection_2D);
+		const SpriteBatch &batch = registry.spriteBatches.get(entity);
+		renderQueue.Push(RENDER_LAYER::CROWD, 0, EFFECT_ASSET_ID::TEXTURED, texture_gl_handles[(GLuint)batch.texture], entity);
 	}
-
-	/* --------------- draw minimap start --------------- */
-	do
+	for (Entity &entity : registry.particleBatches.entities)
 	{
-		if (registry.gameStates.size() == 0) // is in any level
-			break;
-
-		auto &gameState = registry.gameStates.components[0];
-		if (gameState.AtValidLevel() == false)
-			break;
-
-		const vec2 mapSize = gameState.GetMapPixelSize();
-		const float minimapWidth = window_width_px * MINIMAP_WIDTH_COEF;
-		const float scaleCoef = minimapWidth / mapSize.x;
-		const vec2 minimapPos = vec2(MINIMAP_POS_X, MINIMAP_POS_Y);
-
-		// set the view
-		mat3 originViewMatrix = viewMatrix;
-		bool originUseMask = useMask; // minimap not use the mask
-		useMask = false;
-		viewMatrix = mat3(1.0f);
-		viewMatrix = glm::translate(viewMatrix, minimapPos);
-		viewMatrix = glm::scale(viewMatrix, vec2(scaleCoef));
+		const ParticleBatch &batch = registry.particleBatches.get(entity);
+		renderQueue.Push(RENDER_LAYER::EFFECTS, 0, EFFECT_ASSET_ID::PARTICLE, texture_gl_handles[(GLuint)batch.texture], entity);
+	}
+	renderQueue.Sort();
 
-		// draw a temperary background and remove it
+	// the sprites that follow each other with the same texture are drawn together
+	for (size_t i = 0; i < renderQueue.Size(); i++)
+	{
+		Entity entity = renderQueue.Get(i);
+		if (registry.spriteBatches.has(entity))
+		{
+			flushSprites();
+			drawSpriteBatch(entity);
+		}
+		else if (registry.particleBatches.has(entity))
+		{
+			flushSprites();
+			drawParticleBatch(entity);
+		}
+		else
 		{
-			vec2 bgCenter = mapSize / 2.0f - vec2(WALL_SIZE);
-			vec2 bgSize = mapSize - vec2(WALL_SIZE);
-			auto bgEntity = createBackground(this, bgCenter, bgSize, TEXTURE_ASSET_ID::FLOOR_BG);
-			drawTexturedMesh(bgEntity, projection_2D);
-			registry.remove_all_components_of(bgEntity);
+			batchEntity(entity);
 		}
+	}
+	flushSprites();
+
+	/* --------------- draw minimap start --------------- */
+	if (hasMinimap)
+	{
+		// the floor and the walls, colors multiplied by alpha in the texture
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		batchSprites.assign(1, { minimapCacheCenter, minimapCacheSize, 0.f, vec4(0, 0, 1, 1), vec3(1) });
+		drawInstances(EFFECT_ASSET_ID::UI, minimap_texture, batchSprites);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-		// Draw all textured meshes that have a position and size component
+		// the entities that move
+		setFramePass(FRAME_PASS::MINIMAP);
 		for (Entity &entity : registry.renderRequests.entities)
 		{
 			if (!registry.motions.has(entity)) // not motions
 				continue;
 
 			auto &inst = registry.renderRequests.get(entity);
-			if (inst.showOnMinimap == false)
+			if (inst.showOnMinimap == false || registry.staticSprites.has(entity))
 			{
 				continue;
 			}
 
-			// Note, its not very efficient to access elements indirectly via the entity
-			// albeit iterating through all Sprites in sequence. A good point to optimize
-			drawTexturedMesh(entity, projection_2D);
+			batchEntity(entity);
 		}
-
-		// restore
-		useMask = originUseMask;
-		viewMatrix = originViewMatrix;
-
-	} while (0);
+		flushSprites();
+	}
 	/* --------------- draw minimap end --------------- */
 
 	// Truely render to the screen
 	drawToScreen();
+	lastDrawCallCount = drawCallCount;
+	lastVisibleCount = visibleCount;
+	lastCulledCount = culledCount;
+
+	// the gpu is done with the regions of this frame after these draws
+	instance_stream.EndFrame();
+	uniform_stream.EndFrame();
 
 	// flicker-free display with a double buffer
 	glfwSwapBuffers(window);
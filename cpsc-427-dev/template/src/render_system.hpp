@@ -6,6 +6,103 @@
 #include "common.hpp"
 #include "components.hpp"
 #include "tiny_ecs.hpp"
+#include "spatial_grid.hpp"
+#include "render_queue.hpp"
+#include "stream_buffer.hpp"
+#include "texture_loader.hpp"
+
+// the images no bigger than ATLAS_MAX_SPRITE_SIZE on both sides are packed in square atlases of
+// ATLAS_SIZE, with ATLAS_BORDER pixels repeated around every image
+const int ATLAS_SIZE = 2048;
+const int ATLAS_MAX_SPRITE_SIZE = 1024;
+const int ATLAS_BORDER = 2;
+
+// the textures are loaded by groups, the ones of the screens that use them. a group is decoded on
+// a background thread when one of its textures is drawn, and deleted after TEXTURE_EVICT_FRAMES
+// frames without any of them
+enum class TEXTURE_GROUP {
+	COVER = 0,
+	SELECTION = COVER + 1,
+	TUTORIAL = SELECTION + 1,
+	PLAY = TUTORIAL + 1,
+	GROUP_COUNT = PLAY + 1
+};
+const int texture_group_count = (int)TEXTURE_GROUP::GROUP_COUNT;
+TEXTURE_GROUP get_texture_group(TEXTURE_ASSET_ID id);
+
+const int TEXTURE_EVICT_FRAMES = 600;
+
+// the pixels uploaded to the textures in a frame, at most (bytes). a big image takes a few frames
+const size_t TEXTURE_UPLOAD_BUDGET = 2 * 1024 * 1024;
+
+// the atlas of a group is the smallest square page from this size that holds all its small images
+const int ATLAS_MIN_SIZE = 256;
+
+// the cells of the grid over the static layer (pixels)
+const float STATIC_GRID_CELL_SIZE = 160.0f;
+
+// the bytes of sprite instances a frame can write before the instance stream grows
+const GLsizeiptr INSTANCE_STREAM_REGION_SIZE = 256 * 1024;
+
+// the depth of a y-sorted sprite is the bottom of the sprite from the top of the view rect, this
+// many pixels higher, in steps of 1 / RENDER_DEPTH_STEPS pixel
+const float RENDER_DEPTH_MARGIN = 4096.0f;
+const float RENDER_DEPTH_STEPS = 4.0f;
+
+// one sprite of an instanced draw, read by the sprite_batch shader
+struct SpriteInstance
+{
+	vec2 position;
+	vec2 scale;
+	float angle;
+	vec4 uvRect; // (u0, v0, u1, v1), the whole texture is (0, 0, 1, 1)
+	vec3 color;
+};
+
+// the passes of a frame, every one has its FrameUniforms
+enum class FRAME_PASS {
+	WORLD = 0, // the view of the camera and the mask
+	MINIMAP = WORLD + 1,
+	SCREEN = MINIMAP + 1, // ui effects, no view and no mask
+	MINIMAP_CACHE = SCREEN + 1, // the static part of the minimap, into its texture
+	PASS_COUNT = MINIMAP_CACHE + 1
+};
+const int frame_pass_count = (int)FRAME_PASS::PASS_COUNT;
+
+// the FrameUniforms block of the shaders, in the std140 layout (the columns of a mat3 are vec4)
+struct FrameUniforms
+{
+	vec4 projection[3];
+	vec4 view[3];
+	vec2 playerPos;
+	float rBright;
+	float rDark;
+	int useMask;
+	float padding[3];
+};
+const GLuint FRAME_UNIFORMS_BINDING = 0;
+
+// the locations of an effect's attributes and uniforms, found once when it is loaded. -1 when
+// the effect doesn't have it
+struct EffectLocations
+{
+	GLint in_position;
+	GLint in_texcoord;
+	GLint in_color;
+	GLint in_offset;
+	GLint in_scale;
+	GLint in_angle;
+	GLint in_uv_rect;
+	GLint in_motion;
+	GLint in_wave;
+	GLint in_shape;
+	GLint in_life;
+	GLint fcolor;
+	GLint transform;
+	GLint uv_rect;
+	GLint time;
+	GLint darken_screen_factor;
+};
 
 // System responsible for setting up OpenGL and for rendering all the
 // visual entities in the game
@@ -17,9 +114,35 @@ class RenderSystem {
 	 * Whenever possible, add to these lists instead of creating dynamic state
 	 * it is easier to debug and faster to execute for the computer.
 	 */
-	std::array<GLuint, texture_count> texture_gl_handles;
+	std::array<GLuint, texture_count> texture_gl_handles; // the atlas holding the texture, its own texture, or the placeholder
+	std::array<vec4, texture_count> texture_uv_rects; // where the texture is in it, (u0, v0, u1, v1)
 	std::array<ivec2, texture_count> texture_dimensions;
 
+	// where the texture goes when its group is loaded: a page of the group's atlas and the
+	// position in it, with the border. page -1 for the big images, they have their own texture
+	std::array<int, texture_count> texture_page_indices;
+	std::array<ivec2, texture_count> texture_positions;
+	std::array<GLuint, texture_count> texture_own_handles = {};
+
+	enum class TEXTURE_STATE { EVICTED, LOADING, RESIDENT };
+	std::array<TEXTURE_STATE, texture_count> texture_states;
+
+	struct TextureGroup
+	{
+		std::vector<uint> textures;
+		std::vector<int> pageSizes; // the square pages of its atlas
+		std::vector<GLuint> pages; // empty when the group is not loaded
+		bool loaded = false; // the textures are resident or on their way
+		int unusedFrames = 0;
+	};
+	std::array<TextureGroup, texture_group_count> texture_group_states;
+	GLuint placeholder_texture;
+
+	// the images are decoded by the loader, the main thread uploads them in slices
+	TextureLoader texture_loader;
+	std::vector<uint> texture_jobs; // the images to submit, the loader queue was full
+	int texture_upload_row = 0; // the rows of the loader's oldest result that are uploaded
+
 	// Make sure these paths remain in sync with the associated enumerators.
 	// Associated id with .obj path
 	const std::vector < std::pair<GEOMETRY_BUFFER_ID, std::string>> mesh_paths =
@@ -139,23 +262,31 @@ class RenderSystem {
 	};
 
 	std::array<GLuint, effect_count> effects;
+	std::array<EffectLocations, effect_count> effect_locations;
 	// Make sure these paths remain in sync with the associated enumerators.
 	const std::array<std::string, effect_count> effect_paths = {
 		shader_path("egg"),
 		shader_path("wind"),
 		shader_path("textured"),
-		shader_path("ui") };
+		shader_path("ui"),
+		shader_path("sprite_batch"),
+		shader_path("particle") };
 
 	std::array<GLuint, geometry_count> vertex_buffers;
 	std::array<GLuint, geometry_count> index_buffers;
+	std::array<GLsizei, geometry_count> index_counts = {};
+	std::array<GLsizei, geometry_count> vertex_strides = {}; // the size of the vertex type
+
+	// the vertex array of every geometry with every effect that reads its vertex type, 0 for the others
+	std::array<std::array<GLuint, effect_count>, geometry_count> vertex_arrays = {};
 	std::array<Mesh, geometry_count> meshes;
 
 public:
 	// Initialize the window
 	bool init(GLFWwindow* window);
 
-	template <class T>
-	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices);
+	template <class T, class I>
+	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<I> indices);
 
 	void initializeGlTextures();
 
@@ -165,6 +296,11 @@ public:
 	Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 
 	void initializeGlGeometryBuffers();
+	// the vertex arrays, after the effects and the geometry buffers
+	void initializeGlVertexArrays();
+
+	// the instance attributes of the SPRITE_BATCH vertex array read the instance stream from offset
+	void pointInstanceAttributes(GLintptr offset);
 	// Initialize the screen texture used as intermediate render target
 	// The draw loop first renders to this texture, then it is used for the wind
 	// shader
@@ -187,9 +323,69 @@ public:
 
 	mat3 createProjectionMatrix();
 
+	// draw calls of the last frame
+	int GetDrawCallCount() const { return lastDrawCallCount; }
+
+	// sprites of the world pass (entities, static quads and batched sprites) of the last frame
+	// that were on the screen, and the ones that were not submitted
+	int GetVisibleCount() const { return lastVisibleCount; }
+	int GetCulledCount() const { return lastCulledCount; }
+
+	// the frames that waited for the gpu before writing the instances or the uniforms, since init
+	int GetFenceWaitCount() const { return instance_stream.GetFenceWaitCount() + uniform_stream.GetFenceWaitCount(); }
+
+	// bake the StaticSprite entities into one vertex buffer, in the order of the registry, after a
+	// level is loaded. they are drawn below the other entities, one call per run of the same
+	// texture. removing one of them only collapses its quad in the buffer
+	void bakeStaticLayer();
+
 private:
 	// Internal drawing functions for each entity type
-	void drawTexturedMesh(Entity entity, const mat3& projection);
+	void drawTexturedMesh(Entity entity);
+	void drawSpriteBatch(Entity entity);
+	void drawParticleBatch(Entity entity);
+
+	// a buffer for every new ParticleBatch, the dirty ones uploaded again, the ones of removed
+	// batches deleted
+	void updateParticleBuffers();
+
+	// load the groups of the textures drawn, evict the ones that were not for a while, and upload
+	// the decoded images within TEXTURE_UPLOAD_BUDGET
+	void updateTextureStreaming();
+	void loadTextureGroup(TEXTURE_GROUP group);
+	void evictTextureGroup(TEXTURE_GROUP group);
+	// upload the next rows of an image, true when it is all uploaded
+	bool uploadTextureSlice(TextureResult &result, size_t &budget);
+
+	// collapse the quads of the static sprites removed since the last frame
+	void updateStaticLayer();
+	// the indices of the static quads in the view rect, from the grid
+	void cullStaticLayer();
+	void drawStaticLayer(bool minimap);
+
+	// the part of the world on the screen, for the world pass
+	void updateViewRect();
+	// false when the sprite at position, of scale and angle, is out of the view rect
+	bool isInView(vec2 position, vec2 scale, float angle) const;
+
+	// where the minimap and its cached texture are, false when it isn't drawn (not in a level)
+	bool updateMinimapLayout();
+	// draw the floor and the walls into the minimap texture
+	void renderMinimapCache();
+
+	// write the uniforms of every pass, once per frame
+	void updateFrameUniforms(const mat3& projection, bool hasMinimap);
+
+	// the pass of the next draws, and the block read by the next draw of effect
+	void setFramePass(FRAME_PASS pass);
+	void bindFrameUniforms(EFFECT_ASSET_ID effect);
+
+	// sprites of the same effect and atlas that are drawn one after the other are collected,
+	// and drawn with one instanced call when the effect or the texture changes (or at a flush).
+	// the other entities are drawn on their own, after the sprites collected before them
+	void batchEntity(Entity entity);
+	void flushSprites();
+	void drawInstances(EFFECT_ASSET_ID effect, GLuint texture, const std::vector<SpriteInstance>& instances);
 	void drawToScreen();
 
 	// Window handle
@@ -200,6 +396,94 @@ private:
 	GLuint off_screen_render_buffer_color;
 	GLuint off_screen_render_buffer_depth;
 
+	// bound outside of the draws
+	GLuint default_vertex_array;
+
+	// the sprites of the instanced draws of the frame
+	StreamBuffer instance_stream;
+
+	// the FrameUniforms of every pass, one after the other at frame_uniforms_stride bytes (the
+	// alignment of the buffer ranges), from frame_uniforms_offset
+	StreamBuffer uniform_stream;
+	GLint uniform_alignment = 1;
+	GLint frame_uniforms_stride;
+	GLintptr frame_uniforms_offset = 0;
+	std::vector<uint8_t> frameUniformData;
+	FRAME_PASS framePass;
+	int boundFramePass = -1;
+
+	// the sprites collected by batchEntity(), all of the same effect and gl texture (the frames of
+	// one atlas go in the same batch)
+	std::vector<SpriteInstance> pendingSprites;
+	EFFECT_ASSET_ID pendingEffect;
+	GLuint pendingTexture;
+	std::vector<SpriteInstance> batchSprites; // the sprites of a SpriteBatch
+
+	// the particles of a ParticleBatch on the gpu, with the vertex array that reads them
+	struct ParticleBuffer
+	{
+		Entity entity;
+		GLuint buffer;
+		GLuint vertex_array;
+		GLsizei count;
+	};
+	std::vector<ParticleBuffer> particleBuffers;
+
+	// the quads of the static layer with the same texture, drawn with one call
+	struct StaticRun
+	{
+		GLuint texture;
+		GLsizei first; // index
+		GLsizei count;
+		bool showOnMinimap;
+	};
+	std::vector<StaticRun> staticRuns;
+	std::vector<Entity> staticEntities; // the entity of every quad
+	std::vector<TexturedVertex> staticVertices;
+	size_t staticLiveCount = 0; // the quads not collapsed
+
+	// the index buffer of the layer has the indices of every quad, then room for the ones on the
+	// screen of this frame. they are 32 bits, a level can have more than 16384 quads. the grid has the centers of the quads up to the size of a cell, the
+	// bigger ones are tested every frame
+	UniformGrid staticGrid;
+	std::vector<int> staticGridQuads; // the quad of every item of the grid
+	std::vector<float> staticCenterX, staticCenterY;
+	float staticMaxHalfExtent = 0; // of the quads in the grid
+	std::vector<int> staticLargeQuads;
+	std::vector<int> staticVisibleQuads;
+	std::vector<uint32_t> staticVisibleIndices;
+	std::vector<StaticRun> staticVisibleRuns;
+
+	// the minimap: the floor and the walls are drawn into minimap_texture when a level is baked or
+	// walls are removed, the frames draw the texture and the other entities of the minimap
+	GLuint minimap_frame_buffer;
+	GLuint minimap_texture;
+	ivec2 minimapTextureSize = { 0, 0 }; // pixels
+	bool minimapDirty = true;
+	mat3 minimapView; // the world to the screen
+	mat3 minimapCacheView; // the world to the texture
+	mat3 minimapCacheProjection;
+	vec2 minimapMapSize;
+	vec2 minimapCacheCenter; // the texture on the screen
+	vec2 minimapCacheSize;
+
+	// the view rect of the world pass
+	vec2 viewMin;
+	vec2 viewMax;
+
+	// the entities and the crowds of the world pass, sorted by layer, depth and state
+	RenderQueue renderQueue;
+	// the key depth of a sprite of a y-sorted layer
+	uint32_t depthOf(const Motion &motion) const;
+
+	int visibleCount = 0;
+	int culledCount = 0;
+	int lastVisibleCount = 0;
+	int lastCulledCount = 0;
+
+	int drawCallCount = 0;
+	int lastDrawCallCount = 0;
+
 	Entity screen_state_entity;
 };
 
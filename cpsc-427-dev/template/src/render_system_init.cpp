@@ -1,10 +1,13 @@
 // internal
 #include "render_system.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <fstream>
 
 #include "../ext/stb_image/stb_image.h"
+#include "texture_atlas.hpp"
 
 // This creates circular header inclusion, that is quite bad.
 #include "tiny_ecs_registry.hpp"
@@ -12,6 +15,7 @@
 // stlib
 #include <iostream>
 #include <sstream>
+#include <tuple>
 
 // World initialization
 bool RenderSystem::init(GLFWwindow* window_arg)
@@ -48,47 +52,137 @@ bool RenderSystem::init(GLFWwindow* window_arg)
 	// code to use OpenGL 4.3 (not suported on mac) and add additional .h and .cpp
 	// glDebugMessageCallback((GLDEBUGPROC)errorCallback, nullptr);
 
-	// We are not really using VAO's but without at least one bound we will crash in
+	// the draws bind the vertex array of their geometry and effect (initializeGlVertexArrays),
+	// this one is bound the rest of the time: without at least one bound we will crash in
 	// some systems.
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	glGenVertexArrays(1, &default_vertex_array);
+	glBindVertexArray(default_vertex_array);
+	gl_has_errors();
+
+	instance_stream.Init(GL_ARRAY_BUFFER, INSTANCE_STREAM_REGION_SIZE);
+
+	// the uniforms of the passes, every range has to start at the alignment of the driver
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+	frame_uniforms_stride = ((GLint)sizeof(FrameUniforms) + uniform_alignment - 1) / uniform_alignment * uniform_alignment;
+	uniform_stream.Init(GL_UNIFORM_BUFFER, frame_uniforms_stride * frame_pass_count);
 	gl_has_errors();
 
 	initScreenTexture();
     initializeGlTextures();
 	initializeGlEffects();
 	initializeGlGeometryBuffers();
+	initializeGlVertexArrays();
+	glBindVertexArray(default_vertex_array);
+	gl_has_errors();
 
 	return true;
 }
 
+TEXTURE_GROUP get_texture_group(TEXTURE_ASSET_ID id)
+{
+	switch (id)
+	{
+	case TEXTURE_ASSET_ID::COVER0:
+	case TEXTURE_ASSET_ID::COVER1:
+	case TEXTURE_ASSET_ID::COVER2:
+	case TEXTURE_ASSET_ID::COVER3:
+	case TEXTURE_ASSET_ID::TITLE:
+	case TEXTURE_ASSET_ID::PRESS_ANY:
+		return TEXTURE_GROUP::COVER;
+	case TEXTURE_ASSET_ID::SELECTION_BG:
+	case TEXTURE_ASSET_ID::TUTORIAL_BUTTON:
+		return TEXTURE_GROUP::SELECTION;
+	case TEXTURE_ASSET_ID::TUTORIAL_CONTENT:
+		return TEXTURE_GROUP::TUTORIAL;
+	default:
+		// the level buttons
+		if (id >= TEXTURE_ASSET_ID::LEVEL1 && id <= TEXTURE_ASSET_ID::LEVEL6_LOCKED)
+			return TEXTURE_GROUP::SELECTION;
+		return TEXTURE_GROUP::PLAY;
+	}
+}
+
 void RenderSystem::initializeGlTextures()
 {
-    glGenTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+	// square atlases, as big as the driver allows up to ATLAS_SIZE
+	GLint max_texture_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	const int atlas_size = std::min(ATLAS_SIZE, (int)max_texture_size);
+	const int max_sprite_size = std::min(ATLAS_MAX_SPRITE_SIZE, atlas_size - 2 * ATLAS_BORDER);
+
+	// drawn instead of the textures that are not uploaded yet
+	const uint8_t placeholder_pixel[4] = { 64, 64, 64, 255 };
+	glGenTextures(1, &placeholder_texture);
+	glBindTexture(GL_TEXTURE_2D, placeholder_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_pixel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	gl_has_errors();
 
-    for(uint i = 0; i < texture_paths.size(); i++)
-    {
+	// the sizes only, the images are decoded when their group is used
+	for (uint i = 0; i < texture_paths.size(); i++)
+	{
 		const std::string& path = texture_paths[i];
 		ivec2& dimensions = texture_dimensions[i];
-
-		stbi_uc* data;
-		data = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
-
-		if (data == NULL)
+		if (!stbi_info(path.c_str(), &dimensions.x, &dimensions.y, NULL))
 		{
 			const std::string message = "Could not load the file " + path + ".";
 			fprintf(stderr, "%s", message.c_str());
 			assert(false);
 		}
-		glBindTexture(GL_TEXTURE_2D, texture_gl_handles[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		gl_has_errors();
-		stbi_image_free(data);
-    }
-	gl_has_errors();
+
+		texture_states[i] = TEXTURE_STATE::EVICTED;
+		texture_gl_handles[i] = placeholder_texture;
+		texture_uv_rects[i] = vec4(0, 0, 1, 1);
+		texture_page_indices[i] = -1;
+		texture_group_states[(int)get_texture_group((TEXTURE_ASSET_ID)i)].textures.push_back(i);
+	}
+
+	// the small images of every group are packed from the tallest one, in one page as small as
+	// possible, or else in as many pages of atlas_size as needed
+	for (TextureGroup& group : texture_group_states)
+	{
+		std::vector<uint> packed;
+		for (uint i : group.textures)
+		{
+			if (texture_dimensions[i].x <= max_sprite_size && texture_dimensions[i].y <= max_sprite_size)
+				packed.push_back(i);
+		}
+		std::stable_sort(packed.begin(), packed.end(), [this](uint a, uint b) {
+			return texture_dimensions[a].y > texture_dimensions[b].y;
+		});
+
+		auto pack = [&](int page_size, bool one_page) {
+			std::vector<SkylinePacker> packers;
+			for (uint i : packed)
+			{
+				const ivec2 size = texture_dimensions[i] + 2 * ATLAS_BORDER;
+				size_t page = 0;
+				while (page < packers.size() && !packers[page].Insert(size, texture_positions[i]))
+					page++;
+				if (page == packers.size())
+				{
+					if (one_page && !packers.empty())
+						return false;
+					packers.emplace_back();
+					packers.back().Init(page_size, page_size);
+					if (!packers.back().Insert(size, texture_positions[i]))
+						return false;
+				}
+				texture_page_indices[i] = (int)page;
+			}
+			group.pageSizes.assign(packers.size(), page_size);
+			return true;
+		};
+
+		int page_size = ATLAS_MIN_SIZE;
+		while (page_size < atlas_size && !pack(page_size, true))
+			page_size *= 2;
+		if (page_size >= atlas_size)
+			pack(atlas_size, false);
+	}
+
+	texture_loader.Start();
 }
 
 void RenderSystem::initializeGlEffects()
@@ -100,13 +194,42 @@ void RenderSystem::initializeGlEffects()
 
 		bool is_valid = loadEffectFromFile(vertex_shader_name, fragment_shader_name, effects[i]);
 		assert(is_valid && (GLuint)effects[i] != 0);
+
+		// the locations are looked up once, not at every draw
+		const GLuint program = effects[i];
+		EffectLocations& locations = effect_locations[i];
+		locations.in_position = glGetAttribLocation(program, "in_position");
+		locations.in_texcoord = glGetAttribLocation(program, "in_texcoord");
+		locations.in_color = glGetAttribLocation(program, "in_color");
+		locations.in_offset = glGetAttribLocation(program, "in_offset");
+		locations.in_scale = glGetAttribLocation(program, "in_scale");
+		locations.in_angle = glGetAttribLocation(program, "in_angle");
+		locations.in_uv_rect = glGetAttribLocation(program, "in_uv_rect");
+		locations.in_motion = glGetAttribLocation(program, "in_motion");
+		locations.in_wave = glGetAttribLocation(program, "in_wave");
+		locations.in_shape = glGetAttribLocation(program, "in_shape");
+		locations.in_life = glGetAttribLocation(program, "in_life");
+		locations.fcolor = glGetUniformLocation(program, "fcolor");
+		locations.transform = glGetUniformLocation(program, "transform");
+		locations.uv_rect = glGetUniformLocation(program, "uv_rect");
+		locations.time = glGetUniformLocation(program, "time");
+		locations.darken_screen_factor = glGetUniformLocation(program, "darken_screen_factor");
+
+		// the effects with the view read it from the frame uniforms
+		GLuint block_index = glGetUniformBlockIndex(program, "FrameUniforms");
+		if (block_index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, block_index, FRAME_UNIFORMS_BINDING);
+		gl_has_errors();
 	}
 }
 
 // One could merge the following two functions as a template function...
-template <class T>
-void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices)
+template <class T, class I>
+void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<I> indices)
 {
+	// the index buffer binding belongs to the bound vertex array, not to one of the draws
+	glBindVertexArray(default_vertex_array);
+
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)gid]);
 	glBufferData(GL_ARRAY_BUFFER,
 		sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
@@ -115,6 +238,88 @@ void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)gid]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 		sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	index_counts[(uint)gid] = (GLsizei)indices.size();
+	vertex_strides[(uint)gid] = (GLsizei)sizeof(T);
+	gl_has_errors();
+}
+
+void RenderSystem::initializeGlVertexArrays()
+{
+	for (uint g = 0; g < geometry_count; g++)
+	{
+		for (uint e = 0; e < effect_count; e++)
+		{
+			const EFFECT_ASSET_ID effect = (EFFECT_ASSET_ID)e;
+			const EffectLocations& locations = effect_locations[e];
+
+			// the vertex type the effect reads, only the geometries made of it get a vertex array
+			GLsizei stride = (GLsizei)sizeof(TexturedVertex);
+			if (effect == EFFECT_ASSET_ID::EGG)
+				stride = (GLsizei)sizeof(ColoredVertex);
+			else if (effect == EFFECT_ASSET_ID::WIND)
+				stride = (GLsizei)sizeof(vec3);
+			if (vertex_strides[g] != stride)
+				continue;
+
+			// every particle batch has its own buffer, and its own vertex array (updateParticleBuffers)
+			if (effect == EFFECT_ASSET_ID::PARTICLE)
+				continue;
+
+			GLuint& vertex_array = vertex_arrays[g][e];
+			glGenVertexArrays(1, &vertex_array);
+			glBindVertexArray(vertex_array);
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[g]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[g]);
+			gl_has_errors();
+
+			glEnableVertexAttribArray(locations.in_position);
+			glVertexAttribPointer(locations.in_position, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+			if (effect == EFFECT_ASSET_ID::EGG)
+			{
+				glEnableVertexAttribArray(locations.in_color);
+				glVertexAttribPointer(locations.in_color, 3, GL_FLOAT, GL_FALSE, stride, (void*)sizeof(vec3));
+			}
+			else if (effect != EFFECT_ASSET_ID::WIND)
+			{
+				assert(locations.in_texcoord >= 0);
+				glEnableVertexAttribArray(locations.in_texcoord);
+				glVertexAttribPointer(locations.in_texcoord, 2, GL_FLOAT, GL_FALSE, stride, (void*)sizeof(vec3));
+			}
+			gl_has_errors();
+
+			// the instanced sprites read the instance stream once per sprite
+			if (effect == EFFECT_ASSET_ID::SPRITE_BATCH)
+			{
+				pointInstanceAttributes(0);
+				for (GLint loc : { locations.in_offset, locations.in_scale, locations.in_angle, locations.in_uv_rect, locations.in_color })
+				{
+					assert(loc >= 0);
+					glEnableVertexAttribArray(loc);
+					glVertexAttribDivisor(loc, 1);
+				}
+				gl_has_errors();
+			}
+		}
+	}
+}
+
+void RenderSystem::pointInstanceAttributes(GLintptr offset)
+{
+	// (location, floats, offset)
+	const EffectLocations& locations = effect_locations[(GLuint)EFFECT_ASSET_ID::SPRITE_BATCH];
+	const std::array<std::tuple<GLint, GLint, size_t>, 5> instance_attributes = { {
+		std::make_tuple(locations.in_offset, 2, offsetof(SpriteInstance, position)),
+		std::make_tuple(locations.in_scale, 2, offsetof(SpriteInstance, scale)),
+		std::make_tuple(locations.in_angle, 1, offsetof(SpriteInstance, angle)),
+		std::make_tuple(locations.in_uv_rect, 4, offsetof(SpriteInstance, uvRect)),
+		std::make_tuple(locations.in_color, 3, offsetof(SpriteInstance, color)) } };
+
+	glBindBuffer(GL_ARRAY_BUFFER, instance_stream.GetBuffer());
+	for (const auto& attribute : instance_attributes)
+	{
+		glVertexAttribPointer(std::get<0>(attribute), std::get<1>(attribute), GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+			(void*)(offset + std::get<2>(attribute)));
+	}
 	gl_has_errors();
 }
 
@@ -163,6 +368,9 @@ void RenderSystem::initializeGlGeometryBuffers()
 	const std::vector<uint16_t> textured_indices = { 0, 3, 1, 1, 3, 2 };
 	bindVBOandIBO(GEOMETRY_BUFFER_ID::SPRITE, textured_vertices, textured_indices);
 
+	// the static layer is empty until a level is loaded, it has 32 bit indices
+	bindVBOandIBO(GEOMETRY_BUFFER_ID::STATIC_LAYER, std::vector<TexturedVertex>(), std::vector<uint32_t>());
+
 	////////////////////////
 	//// Initialize egg
 	//std::vector<ColoredVertex> egg_vertices;
@@ -227,12 +435,29 @@ void RenderSystem::initializeGlGeometryBuffers()
 
 RenderSystem::~RenderSystem()
 {
+	// no image decoded after this
+	texture_loader.Stop();
+
 	// Don't need to free gl resources since they last for as long as the program,
 	// but it's polite to clean after yourself.
 	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
 	glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
-	glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+	instance_stream.Destroy();
+	for (const ParticleBuffer& particles : particleBuffers)
+	{
+		glDeleteBuffers(1, &particles.buffer);
+		glDeleteVertexArrays(1, &particles.vertex_array);
+	}
+	uniform_stream.Destroy();
+	glDeleteVertexArrays(1, &default_vertex_array);
+	for (auto& effect_vertex_arrays : vertex_arrays)
+		glDeleteVertexArrays((GLsizei)effect_vertex_arrays.size(), effect_vertex_arrays.data());
+	for (uint i = 0; i < texture_group_count; i++)
+		evictTextureGroup((TEXTURE_GROUP)i);
+	glDeleteTextures(1, &placeholder_texture);
 	glDeleteTextures(1, &off_screen_render_buffer_color);
+	glDeleteTextures(1, &minimap_texture);
+	glDeleteFramebuffers(1, &minimap_frame_buffer);
 	glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
 	gl_has_errors();
 
@@ -272,6 +497,20 @@ bool RenderSystem::initScreenTexture()
 
 	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 
+	// the minimap texture, its size is set with the level (updateMinimapLayout)
+	glGenFramebuffers(1, &minimap_frame_buffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, minimap_frame_buffer);
+	glGenTextures(1, &minimap_texture);
+	glBindTexture(GL_TEXTURE_2D, minimap_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, minimap_texture, 0);
+	gl_has_errors();
+	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+
 	return true;
 }
 
@@ -0,0 +1,112 @@
+#pragma once
+
+// stlib
+#include <algorithm>
+#include <vector>
+
+// only glm, like the navigation code
+#include <glm/vec2.hpp>
+#include <glm/ext/vector_int2.hpp>
+#include <glm/common.hpp>
+
+/*
+* uniform grid over a rectangle of the world, for "what is near this point" queries
+*
+* it is built again from scratch when the items moved: a counting sort puts the items of every cell
+* next to each other, so cell c holds items[cellStart[c] .. cellStart[c + 1]). building costs two
+* passes over the items and no allocation once the arrays have grown. items outside of the
+* rectangle are put in the nearest border cell.
+*/
+class UniformGrid
+{
+public:
+	UniformGrid() :origin(0), cellSize(1), invCellSize(1), cols(0), rows(0) {}
+
+	// the rectangle starts at origin and has cols x rows cells of cellSize
+	void Init(glm::vec2 origin, float cellSize, int cols, int rows)
+	{
+		this->origin = origin;
+		this->cellSize = cellSize;
+		invCellSize = 1.0f / cellSize;
+		this->cols = glm::max(cols, 1);
+		this->rows = glm::max(rows, 1);
+		cellStart.assign(this->cols * this->rows + 1, 0);
+	}
+
+	// items are the indices 0..count-1, at (xs[i], ys[i])
+	void Build(const float *xs, const float *ys, int count)
+	{
+		itemCell.resize(count);
+		items.resize(count);
+		std::fill(cellStart.begin(), cellStart.end(), 0);
+
+		for (int i = 0; i < count; ++i)
+		{
+			int cell = GetCell(glm::vec2(xs[i], ys[i]));
+			itemCell[i] = cell;
+			cellStart[cell + 1]++;
+		}
+		for (size_t c = 1; c < cellStart.size(); ++c)
+			cellStart[c] += cellStart[c - 1];
+
+		// cellStart[c + 1] is the end of cell c now. fill every cell from its end, then cellStart[c + 1]
+		// is the start of cell c and the array only has to be shifted by one
+		for (int i = count - 1; i >= 0; --i)
+			items[--cellStart[itemCell[i] + 1]] = i;
+		for (size_t c = 0; c + 1 < cellStart.size(); ++c)
+			cellStart[c] = cellStart[c + 1];
+		cellStart.back() = count;
+	}
+
+	// visit(item) for every item in the cells that overlap [min, max]
+	template <typename F>
+	void QueryRect(glm::vec2 min, glm::vec2 max, F visit) const
+	{
+		glm::ivec2 begin = ToCell(min);
+		glm::ivec2 end = ToCell(max);
+		for (int y = begin.y; y <= end.y; ++y)
+		{
+			for (int x = begin.x; x <= end.x; ++x)
+			{
+				int cell = y * cols + x;
+				for (int k = cellStart[cell]; k < cellStart[cell + 1]; ++k)
+					visit(items[k]);
+			}
+		}
+	}
+
+	// visit(item) for every item in the cells that overlap the square around the circle,
+	// the caller checks the distance
+	template <typename F>
+	void QueryRadius(glm::vec2 center, float radius, F visit) const
+	{
+		QueryRect(center - radius, center + radius, visit);
+	}
+
+	int GetCell(glm::vec2 pos) const
+	{
+		glm::ivec2 cell = ToCell(pos);
+		return cell.y * cols + cell.x;
+	}
+
+	int GetCols() const { return cols; }
+	int GetRows() const { return rows; }
+	float GetCellSize() const { return cellSize; }
+
+private:
+	glm::vec2 origin;
+	float cellSize;
+	float invCellSize;
+	int cols;
+	int rows;
+
+	std::vector<int> cellStart; // cols * rows + 1
+	std::vector<int> items;
+	std::vector<int> itemCell;
+
+	glm::ivec2 ToCell(glm::vec2 pos) const
+	{
+		glm::ivec2 cell(glm::floor((pos - origin) * invCellSize));
+		return glm::clamp(cell, glm::ivec2(0), glm::ivec2(cols - 1, rows - 1));
+	}
+};
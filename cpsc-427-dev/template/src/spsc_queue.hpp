@@ -0,0 +1,79 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/*
+* lock-free ring buffer between exactly one producer thread and one consumer thread
+*
+* the slots are allocated once and reused: the producer fills a slot in place (BeginPush / EndPush)
+* and the consumer reads it in place (Front / Pop), so a slot holding a vector keeps its memory.
+* every call returns at once, a full or empty queue is reported instead of waited on.
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+	SpscQueue() :mask(0), head(0), tail(0) {}
+
+	// capacity must be a power of two. not thread safe, call it before the threads use the queue
+	void Init(size_t capacity)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "SpscQueue capacity must be a power of two");
+		slots.clear();
+		slots.resize(capacity);
+		mask = capacity - 1;
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	// producer: the free slot to fill, nullptr if the queue is full
+	T *BeginPush()
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask)
+			return nullptr;
+		return &slots[t & mask];
+	}
+
+	// producer: publish the slot returned by BeginPush()
+	void EndPush()
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// consumer: the oldest slot, nullptr if the queue is empty
+	T *Front()
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &slots[h & mask];
+	}
+
+	// consumer: give the slot returned by Front() back to the producer
+	void Pop()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// approximate when called while the other thread works on the queue
+	size_t Size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> slots;
+	size_t mask;
+
+	// only written by the consumer / the producer, kept on separate cache lines. padding instead of
+	// alignas, an over-aligned member is not honoured by new before c++17
+	char padHead[64];
+	std::atomic<size_t> head;
+	char padTail[64];
+	std::atomic<size_t> tail;
+};
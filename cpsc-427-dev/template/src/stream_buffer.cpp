@@ -0,0 +1,101 @@
+// internal
+#include "stream_buffer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+// how long a wait for a fence lasts before trying again (nanoseconds)
+const GLuint64 STREAM_FENCE_TIMEOUT = 1000000000;
+
+void StreamBuffer::Init(GLenum target, GLsizeiptr regionSize)
+{
+	this->target = target;
+	glGenBuffers(1, &buffer);
+	region = 0;
+	used = 0;
+	fenceWaits = 0;
+	this->regionSize = 0;
+	Grow(regionSize);
+}
+
+void StreamBuffer::Destroy()
+{
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void StreamBuffer::Grow(GLsizeiptr size)
+{
+	// the draws of the frames in flight keep the storage they read
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+
+	while (regionSize < size)
+		regionSize = regionSize > 0 ? regionSize * 2 : size;
+	glBindBuffer(target, buffer);
+	glBufferData(target, regionSize * STREAM_BUFFER_REGIONS, nullptr, GL_STREAM_DRAW);
+	gl_has_errors();
+	used = 0;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	region = (region + 1) % STREAM_BUFFER_REGIONS;
+	used = 0;
+
+	GLsync &fence = fences[region];
+	if (!fence)
+		return;
+
+	// done already in most frames, else the gpu is STREAM_BUFFER_REGIONS - 1 frames behind
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		fenceWaits++;
+		do
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	assert(status != GL_WAIT_FAILED);
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+GLintptr StreamBuffer::Write(const void *data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLsizeiptr offset = (used + alignment - 1) / alignment * alignment;
+	if (offset + size > regionSize)
+	{
+		Grow(offset + size);
+		offset = 0;
+	}
+
+	// the gpu doesn't read this range any more (BeginFrame), no need for the driver to check
+	const GLintptr start = region * regionSize + offset;
+	glBindBuffer(target, buffer);
+	void *mapped = glMapBufferRange(target, start, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	assert(mapped);
+	memcpy(mapped, data, size);
+	glUnmapBuffer(target);
+	gl_has_errors();
+
+	used = offset + size;
+	return start;
+}
+
+void StreamBuffer::EndFrame()
+{
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	gl_has_errors();
+}
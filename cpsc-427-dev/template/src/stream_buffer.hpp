@@ -0,0 +1,56 @@
+#pragma once
+
+// stlib
+#include <array>
+
+#include "common.hpp"
+
+// the frames that can be in flight, each one writes its own region of the buffer
+const int STREAM_BUFFER_REGIONS = 3;
+
+/*
+* a buffer for the data written every frame, in STREAM_BUFFER_REGIONS regions used in turn
+*
+* a frame writes its data one after the other in its region, mapped unsynchronized so the driver
+* never waits for the draws that read the buffer. the draws of the last frames read the other
+* regions; a fence put after the draws of a frame tells when the gpu is done with its region and it
+* can be written again. a frame that doesn't fit in its region grows the buffer, the old storage is
+* left to the draws that read it.
+*
+* gl 3.3 has no persistent mapping, every write maps and unmaps its range.
+*/
+class StreamBuffer
+{
+public:
+	StreamBuffer() :target(0), buffer(0), regionSize(0), region(0), used(0), fenceWaits(0) {}
+
+	void Init(GLenum target, GLsizeiptr regionSize);
+	void Destroy();
+
+	// the next region, once the gpu is done with it
+	void BeginFrame();
+
+	// copy size bytes of data after the ones of this frame, at a multiple of alignment. returns
+	// where they are in the buffer
+	GLintptr Write(const void *data, GLsizeiptr size, GLsizeiptr alignment = 1);
+
+	// after the last draw that reads the region of this frame
+	void EndFrame();
+
+	GLuint GetBuffer() const { return buffer; }
+
+	// the frames that had to wait for the gpu to be done with their region, since Init
+	int GetFenceWaitCount() const { return fenceWaits; }
+
+private:
+	GLenum target;
+	GLuint buffer;
+	GLsizeiptr regionSize;
+	int region;
+	GLsizeiptr used; // bytes of the region written by this frame
+	std::array<GLsync, STREAM_BUFFER_REGIONS> fences = {};
+	int fenceWaits;
+
+	// new storage with regions of at least size, the fences were for the old one
+	void Grow(GLsizeiptr size);
+};
@@ -0,0 +1,196 @@
+// internal
+#include "swarm_system.hpp"
+#include "force_field.hpp"
+
+#include <algorithm>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+using namespace std;
+using glm::vec2;
+
+// the grid never has more cells than this on a side, its cells grow when the bees are spread out
+const int SWARM_MAX_GRID_SIZE = 256;
+
+// bees per chunk of the separation pass
+const int SWARM_MIN_CHUNK = 128;
+
+// steering and integration of count bees. the arrays never overlap: with __restrict the compiler
+// vectorizes the loop without checking every pair of them at run time
+static void SteerBees(int count, float dt, vec2 targetPos,
+	float *__restrict px, float *__restrict py, float *__restrict vx, float *__restrict vy, float *__restrict ages,
+	const float *__restrict ox, const float *__restrict oy, const float *__restrict bx, const float *__restrict by,
+	const float *__restrict sx, const float *__restrict sy, const float *__restrict wy)
+{
+	const float goingEnd = BEE_GOING_TIME;
+	const float stayEnd = goingEnd + BEE_STAY_TIME;
+	const float leaveEnd = stayEnd + BEE_LEAVE_TIME;
+	const float steer = glm::min(1.0f, SWARM_STEER_RATE * dt);
+	const float minRemain = glm::max(dt, 1e-3f);
+
+	for (int i = 0; i < count; ++i)
+	{
+		// the phases are 0 / 1 weights instead of branches
+		float a = ages[i];
+		float going = (float)(a < goingEnd);
+		float leaving = (float)(a >= stayEnd);
+
+		// the point to reach, and the time left to reach it
+		float hoverX = targetPos.x + ox[i];
+		float hoverY = targetPos.y + oy[i] + wy[i];
+		float goalX = hoverX + leaving * (bx[i] - hoverX);
+		float goalY = hoverY + leaving * (by[i] - hoverY);
+		float remain = going * (goingEnd - a) + leaving * (leaveEnd - a) + (1.0f - going - leaving) * SWARM_HOVER_TIME;
+		remain = std::max(remain, minRemain);
+
+		float desiredX = (goalX - px[i]) / remain;
+		float desiredY = (goalY - py[i]) / remain;
+
+		vx[i] += (desiredX - vx[i]) * steer + sx[i] * dt;
+		vy[i] += (desiredY - vy[i]) * steer + sy[i] * dt;
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		ages[i] = a + dt;
+	}
+}
+
+void SwarmSystem::Spawn(int count, vec2 bornPos)
+{
+	count = glm::min(count, SWARM_MAX_BEES - GetBeeCount());
+	if (count <= 0)
+		return;
+
+	// about one separation distance of room for every bee
+	cloudRadius = glm::max(SWARM_MIN_CLOUD_RADIUS, SWARM_SEPARATION_DIST * sqrt((float)(GetBeeCount() + count)) * 0.6f);
+
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+	uniform_real_distribution<float> amplitudes(SWARM_WAVE_MIN_AMPLITUDE, SWARM_WAVE_MAX_AMPLITUDE);
+	uniform_real_distribution<float> periods(SWARM_WAVE_MIN_PERIOD, SWARM_WAVE_MAX_PERIOD);
+
+	for (int i = 0; i < count; ++i)
+	{
+		// uniform in the disc
+		float r = cloudRadius * sqrt(unit(rng));
+		float angle = glm::two_pi<float>() * unit(rng);
+
+		// they leave and come back to the nest as a cloud, bees at the same point can't be pushed apart
+		vec2 home = bornPos + 0.5f * r * vec2(cos(angle), sin(angle));
+		posX.push_back(home.x);
+		posY.push_back(home.y);
+		velX.push_back(0);
+		velY.push_back(0);
+		offsetX.push_back(r * cos(angle));
+		offsetY.push_back(r * sin(angle));
+		bornX.push_back(home.x);
+		bornY.push_back(home.y);
+		age.push_back(0);
+		amplitude.push_back(amplitudes(rng));
+		frequency.push_back(glm::two_pi<float>() / periods(rng));
+		sepX.push_back(0);
+		sepY.push_back(0);
+		waveY.push_back(0);
+	}
+}
+
+void SwarmSystem::Clear()
+{
+	posX.clear();
+	posY.clear();
+	velX.clear();
+	velY.clear();
+	offsetX.clear();
+	offsetY.clear();
+	bornX.clear();
+	bornY.clear();
+	age.clear();
+	amplitude.clear();
+	frequency.clear();
+	sepX.clear();
+	sepY.clear();
+	waveY.clear();
+}
+
+void SwarmSystem::RemoveBee(int bee)
+{
+	// swap with the last one, the order of the bees doesn't matter
+	int last = GetBeeCount() - 1;
+	for (vector<float> *field : { &posX, &posY, &velX, &velY, &offsetX, &offsetY, &bornX, &bornY, &age, &amplitude, &frequency, &sepX, &sepY, &waveY })
+	{
+		(*field)[bee] = (*field)[last];
+		field->pop_back();
+	}
+}
+
+void SwarmSystem::ComputeSeparation(int bee)
+{
+	vec2 pos(posX[bee], posY[bee]);
+	vec2 push(0);
+	int found = 0;
+	const float rangeSq = SWARM_SEPARATION_DIST * SWARM_SEPARATION_DIST;
+
+	grid.QueryRadius(pos, SWARM_SEPARATION_DIST, [&](int other) {
+		if (other == bee || found >= SWARM_MAX_NEIGHBOURS)
+			return;
+		vec2 away = pos - vec2(posX[other], posY[other]);
+		float distSq = dot(away, away);
+		if (distSq >= rangeSq || distSq < 1e-6f)
+			return;
+
+		// stronger when closer
+		push += away / distSq;
+		found++;
+	});
+
+	sepX[bee] = push.x * SWARM_SEPARATION_WEIGHT;
+	sepY[bee] = push.y * SWARM_SEPARATION_WEIGHT;
+
+	// hovering bees go up and down
+	bool hovering = age[bee] >= BEE_GOING_TIME && age[bee] < BEE_GOING_TIME + BEE_STAY_TIME;
+	waveY[bee] = hovering ? amplitude[bee] * sin(frequency[bee] * age[bee]) : 0.0f;
+}
+
+void SwarmSystem::step(float elapsed_ms, vec2 targetPos, const ForceField &wind)
+{
+	int count = GetBeeCount();
+	if (count == 0)
+		return;
+
+	float dt = elapsed_ms / 1000.0f;
+
+	// a grid over the bees only, they can be anywhere between the map corner and the target
+	float minX = posX[0], maxX = posX[0], minY = posY[0], maxY = posY[0];
+	for (int i = 1; i < count; ++i)
+	{
+		minX = glm::min(minX, posX[i]);
+		maxX = glm::max(maxX, posX[i]);
+		minY = glm::min(minY, posY[i]);
+		maxY = glm::max(maxY, posY[i]);
+	}
+	float cellSize = glm::max(SWARM_SEPARATION_DIST, glm::max(maxX - minX, maxY - minY) / SWARM_MAX_GRID_SIZE);
+	grid.Init(vec2(minX, minY), cellSize, (int)((maxX - minX) / cellSize) + 1, (int)((maxY - minY) / cellSize) + 1);
+	grid.Build(posX.data(), posY.data(), count);
+
+	parallel.Run(count, SWARM_MIN_CHUNK, [this](int begin, int end) {
+		for (int i = begin; i < end; ++i)
+			ComputeSeparation(i);
+	});
+
+	SteerBees(count, dt, targetPos, posX.data(), posY.data(), velX.data(), velY.data(), age.data(),
+		offsetX.data(), offsetY.data(), bornX.data(), bornY.data(), sepX.data(), sepY.data(), waveY.data());
+
+	// the wind carries the bees on top of their own flight
+	for (int i = 0; i < count; ++i)
+	{
+		vec2 flow = wind.Sample(vec2(posX[i], posY[i]));
+		posX[i] += flow.x * dt;
+		posY[i] += flow.y * dt;
+	}
+
+	// the bees that are back home
+	const float leaveEnd = BEE_GOING_TIME + BEE_STAY_TIME + BEE_LEAVE_TIME;
+	for (int i = count - 1; i >= 0; --i)
+	{
+		if (age[i] >= leaveEnd)
+			RemoveBee(i);
+	}
+}
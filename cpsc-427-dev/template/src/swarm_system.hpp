@@ -0,0 +1,92 @@
+#pragma once
+
+// stlib
+#include <random>
+#include <vector>
+
+#include "spatial_grid.hpp"
+#include "parallel_for.hpp"
+
+class ForceField;
+
+// bee
+const float BEE_GOING_TIME = 2.0f;
+const float BEE_STAY_TIME = 5.0f;
+const float BEE_LEAVE_TIME = 2.0f;
+const int BEE_COUNT = 300; // bees summoned by the bee tool
+
+const int SWARM_MAX_BEES = 8192;
+
+// a bee is pushed away from the bees closer than this (pixels), at most SWARM_MAX_NEIGHBOURS of them
+const float SWARM_SEPARATION_DIST = 12.0f;
+const int SWARM_MAX_NEIGHBOURS = 6;
+
+// how fast a bee turns toward the velocity it wants (per second), and how hard the others push it
+const float SWARM_STEER_RATE = 8.0f;
+const float SWARM_SEPARATION_WEIGHT = 4000.0f;
+
+// a hovering bee goes back to its point of the cloud in about this time (seconds)
+const float SWARM_HOVER_TIME = 0.25f;
+
+// the up and down wave of a hovering bee, pixels and seconds
+const float SWARM_WAVE_MIN_AMPLITUDE = 2.0f;
+const float SWARM_WAVE_MAX_AMPLITUDE = 40.0f;
+const float SWARM_WAVE_MIN_PERIOD = 0.1f;
+const float SWARM_WAVE_MAX_PERIOD = 1.0f;
+
+// the cloud around the target is at least this big (pixels)
+const float SWARM_MIN_CLOUD_RADIUS = 100.0f;
+
+/*
+* the bees of the bee tool, as one swarm of boids
+*
+* a bee is not an entity, the swarm keeps every field of the bees in its own array. every bee flies
+* to a point of the cloud around the target (cohesion), hovers there, then flies back where it was
+* born; the times are BEE_GOING_TIME, BEE_STAY_TIME and BEE_LEAVE_TIME from its birth. the bees
+* closer than SWARM_SEPARATION_DIST push each other (separation), the neighbours are found in a
+* uniform grid built every frame.
+*
+* the separation pass gathers neighbours and runs on the ParallelFor pool. the steering and
+* integration pass only does arithmetic on the arrays, without branches or calls, so the compiler
+* can vectorize it.
+*/
+class SwarmSystem
+{
+public:
+	SwarmSystem() :cloudRadius(0) {}
+
+	// add count bees at bornPos, they fly to the target of step(). the cloud around the target
+	// grows with the number of bees so they have room to hover
+	void Spawn(int count, glm::vec2 bornPos);
+
+	// remove all the bees
+	void Clear();
+
+	// move the bees toward the target, drifting with the wind, and remove the ones that are back home
+	void step(float elapsed_ms, glm::vec2 targetPos, const ForceField &wind);
+
+	int GetBeeCount() const { return (int)posX.size(); }
+	const std::vector<float> &GetX() const { return posX; }
+	const std::vector<float> &GetY() const { return posY; }
+
+private:
+	float cloudRadius;
+
+	// one entry per bee
+	std::vector<float> posX, posY;
+	std::vector<float> velX, velY;
+	std::vector<float> offsetX, offsetY; // the bee's point of the cloud, from the target
+	std::vector<float> bornX, bornY;
+	std::vector<float> age; // seconds
+	std::vector<float> amplitude, frequency; // the hovering wave
+	std::vector<float> sepX, sepY; // separation push of this frame
+	std::vector<float> waveY; // the wave offset of this frame
+
+	UniformGrid grid;
+	ParallelFor parallel;
+	std::minstd_rand rng;
+
+	// the separation push and the wave of one bee, only writes the bee's own entries
+	void ComputeSeparation(int bee);
+	void RemoveBee(int bee);
+};
@@ -0,0 +1,117 @@
+// internal
+#include "texture_atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void SkylinePacker::Init(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	skyline.assign(1, { 0, 0, width });
+}
+
+int SkylinePacker::FitAt(size_t i, int w, int h) const
+{
+	int x = skyline[i].x;
+	if (x + w > width)
+		return -1;
+
+	// the rectangle rests on the highest segment under it
+	int y = 0;
+	int left = w;
+	for (size_t k = i; left > 0; ++k)
+	{
+		y = max(y, skyline[k].y);
+		left -= skyline[k].width;
+	}
+	return y + h <= height ? y : -1;
+}
+
+bool SkylinePacker::Insert(glm::ivec2 size, glm::ivec2 &pos)
+{
+	int bestIndex = -1;
+	int bestTop = height + 1;
+	int bestWidth = width + 1;
+	for (size_t i = 0; i < skyline.size(); ++i)
+	{
+		int y = FitAt(i, size.x, size.y);
+		if (y < 0)
+			continue;
+
+		// the lowest top, then the narrowest segment
+		int top = y + size.y;
+		if (top < bestTop || (top == bestTop && skyline[i].width < bestWidth))
+		{
+			bestIndex = (int)i;
+			bestTop = top;
+			bestWidth = skyline[i].width;
+			pos = glm::ivec2(skyline[i].x, y);
+		}
+	}
+	if (bestIndex < 0)
+		return false;
+
+	// the new segment on top of the rectangle, then cut the segments it covers
+	skyline.insert(skyline.begin() + bestIndex, { pos.x, bestTop, size.x });
+	int right = pos.x + size.x;
+	for (size_t i = bestIndex + 1; i < skyline.size();)
+	{
+		Segment &segment = skyline[i];
+		if (segment.x >= right)
+			break;
+
+		int covered = right - segment.x;
+		if (covered < segment.width)
+		{
+			segment.x += covered;
+			segment.width -= covered;
+			break;
+		}
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// merge the neighbours at the same height
+	for (size_t i = 0; i + 1 < skyline.size();)
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	return true;
+}
+
+void atlas_copy_image(vector<uint8_t> &page, int pageWidth, const uint8_t *image, glm::ivec2 size, glm::ivec2 pos, int border)
+{
+	const int pixelSize = 4;
+	auto pixel = [&](int x, int y) { return &page[((size_t)y * pageWidth + x) * pixelSize]; };
+
+	for (int row = 0; row < size.y; ++row)
+	{
+		int y = pos.y + border + row;
+		memcpy(pixel(pos.x + border, y), image + (size_t)row * size.x * pixelSize, (size_t)size.x * pixelSize);
+
+		// the first and the last pixel of the row, repeated to the left and to the right
+		for (int k = 0; k < border; ++k)
+		{
+			memcpy(pixel(pos.x + k, y), pixel(pos.x + border, y), pixelSize);
+			memcpy(pixel(pos.x + border + size.x + k, y), pixel(pos.x + border + size.x - 1, y), pixelSize);
+		}
+	}
+
+	// the first and the last row with their corners, repeated above and below
+	size_t rowBytes = (size_t)(size.x + 2 * border) * pixelSize;
+	for (int k = 0; k < border; ++k)
+	{
+		memcpy(pixel(pos.x, pos.y + k), pixel(pos.x, pos.y + border), rowBytes);
+		memcpy(pixel(pos.x, pos.y + border + size.y + k), pixel(pos.x, pos.y + border + size.y - 1), rowBytes);
+	}
+}
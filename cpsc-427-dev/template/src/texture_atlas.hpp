@@ -0,0 +1,47 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include <glm/ext/vector_int2.hpp>
+
+/*
+* skyline packer for the rectangles of a texture atlas
+*
+* the skyline is the top edge of the rectangles placed so far, as segments from left to right. a
+* new rectangle is put on the skyline where its top ends the lowest (the bottom-left rule), the
+* space below the skyline that it covers is lost. inserting the rectangles from the tallest to the
+* shortest wastes less of it.
+*/
+class SkylinePacker
+{
+public:
+	SkylinePacker() :width(0), height(0) {}
+
+	// an empty page of width x height pixels
+	void Init(int width, int height);
+
+	// find room for a rectangle of size, false if it doesn't fit in the page any more
+	bool Insert(glm::ivec2 size, glm::ivec2 &pos);
+
+private:
+	struct Segment
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	int width;
+	int height;
+	std::vector<Segment> skyline;
+
+	// the y where a rectangle of width w starting at segment i rests, -1 if it leaves the page
+	int FitAt(size_t i, int w, int h) const;
+};
+
+// copy an image of size (rgba, rows from the top) into a page of pageWidth pixels at pos, and repeat
+// its border pixels border times around it, so that linear filtering at the edge of the image
+// doesn't mix in its neighbours of the atlas
+void atlas_copy_image(std::vector<uint8_t> &page, int pageWidth, const uint8_t *image, glm::ivec2 size, glm::ivec2 pos, int border);
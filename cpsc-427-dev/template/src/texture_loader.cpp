@@ -0,0 +1,99 @@
+// internal
+#include "texture_loader.hpp"
+#include "texture_atlas.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+#include "../ext/stb_image/stb_image.h"
+
+using namespace std;
+
+// an idle worker checks the job queue at least this often, in case a wake-up was missed
+const chrono::milliseconds TEXTURE_LOADER_IDLE_WAIT(5);
+
+void TextureLoader::Start()
+{
+	Stop();
+
+	jobs.Init(TEXTURE_LOADER_QUEUE_SIZE);
+	results.Init(TEXTURE_LOADER_QUEUE_SIZE);
+
+	running = true;
+	thread = std::thread(&TextureLoader::Run, this);
+}
+
+void TextureLoader::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(wakeMutex);
+		running = false;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+bool TextureLoader::Submit(int texture, const string &path, int border)
+{
+	TextureJob *job = jobs.BeginPush();
+	if (job == nullptr)
+		return false;
+
+	job->texture = texture;
+	job->path = path;
+	job->border = border;
+	jobs.EndPush();
+	wake.notify_one();
+	return true;
+}
+
+void TextureLoader::Run()
+{
+	while (running)
+	{
+		TextureJob *job = jobs.Front();
+		if (job == nullptr)
+		{
+			unique_lock<mutex> lock(wakeMutex);
+			wake.wait_for(lock, TEXTURE_LOADER_IDLE_WAIT, [this]() { return !running || jobs.Front() != nullptr; });
+			continue;
+		}
+
+		// the main thread is behind on uploading, the job waits
+		TextureResult *result = results.BeginPush();
+		if (result == nullptr)
+		{
+			unique_lock<mutex> lock(wakeMutex);
+			wake.wait_for(lock, TEXTURE_LOADER_IDLE_WAIT);
+			continue;
+		}
+		Decode(*job, *result);
+		results.EndPush();
+		jobs.Pop();
+	}
+}
+
+void TextureLoader::Decode(const TextureJob &job, TextureResult &result)
+{
+	result.texture = job.texture;
+
+	glm::ivec2 size;
+	stbi_uc *data = stbi_load(job.path.c_str(), &size.x, &size.y, NULL, 4);
+	result.loaded = data != NULL;
+	if (!result.loaded)
+	{
+		fprintf(stderr, "Could not load the file %s.\n", job.path.c_str());
+		result.size = { 0, 0 };
+		result.pixels.clear();
+		return;
+	}
+
+	// the main thread frees the pixels once they are uploaded
+	result.size = size + 2 * job.border;
+	result.pixels.resize((size_t)result.size.x * result.size.y * 4);
+	atlas_copy_image(result.pixels, result.size.x, data, size, { 0, 0 }, job.border);
+	stbi_image_free(data);
+}
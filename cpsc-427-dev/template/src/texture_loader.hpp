@@ -0,0 +1,73 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/ext/vector_int2.hpp>
+
+#include "spsc_queue.hpp"
+
+// images that can wait in the queues at the same time, more than there are textures
+const int TEXTURE_LOADER_QUEUE_SIZE = 128;
+
+// an image to decode
+struct TextureJob
+{
+	int texture = 0; // the TEXTURE_ASSET_ID
+	std::string path;
+	int border = 0; // the pixels repeated around the image, for an atlas
+};
+
+struct TextureResult
+{
+	int texture = 0;
+	bool loaded = false;
+	glm::ivec2 size = { 0, 0 }; // with the border
+	std::vector<uint8_t> pixels; // rgba, rows from the top. emptied after the upload
+};
+
+/*
+* decodes the texture files on a background thread
+*
+* the images are decoded with stb_image in the order they were submitted, the ones for an atlas come
+* back with their border (atlas_copy_image) so the main thread only uploads them. jobs and results
+* go through two single-producer / single-consumer rings like the ones of the PathWorker.
+*/
+class TextureLoader
+{
+public:
+	TextureLoader() :running(false) {}
+	~TextureLoader() { Stop(); }
+
+	TextureLoader(const TextureLoader &) = delete;
+	TextureLoader &operator=(const TextureLoader &) = delete;
+
+	void Start();
+
+	// the images not decoded yet are dropped
+	void Stop();
+
+	// main thread only, return false if the job queue is full
+	bool Submit(int texture, const std::string &path, int border);
+
+	// main thread only: the oldest decoded image, nullptr if none. it stays valid until PopResult()
+	TextureResult *PeekResult() { return results.Front(); }
+	void PopResult() { results.Pop(); }
+
+private:
+	std::thread thread;
+	std::atomic<bool> running;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	SpscQueue<TextureJob> jobs; // main thread -> worker
+	SpscQueue<TextureResult> results; // worker -> main thread
+
+	void Run();
+	void Decode(const TextureJob &job, TextureResult &result);
+};
@@ -42,10 +42,13 @@ public:
 	ComponentContainer<Tool> tools;
 	ComponentContainer<UI> uis;
 	ComponentContainer<Background> background;
-	ComponentContainer<Exploded> explodeds;
 	ComponentContainer<Wind> winds;
-	ComponentContainer<WindParticle> windParticles;
-	ComponentContainer<Bee> bees;
+	ComponentContainer<SimLod> simLods;
+	ComponentContainer<Sight> sights;
+	ComponentContainer<PathFollower> pathFollowers;
+	ComponentContainer<SpriteBatch> spriteBatches;
+	ComponentContainer<ParticleBatch> particleBatches;
+	ComponentContainer<StaticSprite> staticSprites;
 
 	// constructor that adds all containers for looping over them
 	// IMPORTANT: Don't forget to add any newly added containers!
@@ -82,10 +85,13 @@ public:
 		registry_list.push_back(&tools);
 		registry_list.push_back(&uis);
 		registry_list.push_back(&background);
-		registry_list.push_back(&explodeds);
 		registry_list.push_back(&winds);
-		registry_list.push_back(&windParticles);
-		registry_list.push_back(&bees);
+		registry_list.push_back(&simLods);
+		registry_list.push_back(&sights);
+		registry_list.push_back(&pathFollowers);
+		registry_list.push_back(&spriteBatches);
+		registry_list.push_back(&particleBatches);
+		registry_list.push_back(&staticSprites);
 	}
 
 	void clear_all_components() {
@@ -2,6 +2,7 @@
 #include "tiny_ecs_registry.hpp"
 #include <string>
 #include <random>
+#include <algorithm>
 
 using namespace std;
 
@@ -60,6 +61,9 @@ Entity createWall(RenderSystem *renderer, vec2 position)
 
 	// Create an (empty) Bug component to be able to refer to all bug
 	registry.stopables.emplace(entity);
+
+	// drawn with the static layer
+	registry.staticSprites.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::WALL, // TODo
@@ -98,7 +102,8 @@ Entity createExit(RenderSystem *renderer, vec2 position)
 		{ TEXTURE_ASSET_ID::EXIT, // TODo
 			EFFECT_ASSET_ID::TEXTURED,
 			GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::GROUND });
 
 	return entity;
 }
@@ -114,9 +119,16 @@ Entity createGuard(RenderSystem *renderer, vec2 position, vec2 v)
 	// Initialize walk timer
 	registry.turnTimers.emplace(entity, GUARD_TURN_TIME);
 
-	// Create and (empty) Guard component to be able to refer to all guards
+	// Create a Guard component to be able to refer to all guards, it also holds the chasing state
 	registry.guards.emplace(entity);
 
+	// far away guards are simulated less often, and catch up when the player comes closer
+	registry.simLods.emplace(entity, true);
+
+	// the guard chases the player when it sees it, along the path of its last search
+	registry.sights.emplace(entity);
+	registry.pathFollowers.emplace(entity);
+
 	// Initialize the motion
 	auto &motion = registry.motions.emplace(entity);
 	// motion.angle = 0.f;
@@ -175,7 +187,8 @@ Entity createCamera(RenderSystem *renderer, vec2 position, uint16_t direction)
 		{ TEXTURE_ASSET_ID::CAMERA,
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::GROUND });
 
 	return entity;
 }
@@ -191,6 +204,9 @@ Entity createLight(RenderSystem *renderer, vec2 position, uint16_t direction)
 	// Initialize rotate timer
 	registry.turnTimers.emplace(entity, LIGHT_TURN_TIME);
 
+	// far away lights stop rotating
+	registry.simLods.emplace(entity, false);
+
 	// Initialize the motion
 	auto &motion = registry.motions.emplace(entity);
 	if (direction == 0) {
@@ -227,7 +243,8 @@ Entity createLight(RenderSystem *renderer, vec2 position, uint16_t direction)
 		{ TEXTURE_ASSET_ID::LIGHT,
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::EFFECTS });
 
 	return entity;
 }
@@ -261,7 +278,8 @@ Entity createUIBox(RenderSystem *renderer, vec2 position, vec2 size, enum TEXTUR
 		{ textureAssetId, // TEXTURE_ASSET_ID
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -282,6 +300,9 @@ Entity createWind(RenderSystem *renderer, vec2 position, float width, float leng
 
 	registry.winds.emplace(entity, position, width, length, dir);
 
+	// far away winds stop emitting particles
+	registry.simLods.emplace(entity, false);
+
 	// no rendering but let it born particles at render function
 
 	//registry.renderRequests.insert(
@@ -293,61 +314,38 @@ Entity createWind(RenderSystem *renderer, vec2 position, float width, float leng
 	return entity;
 }
 
-Entity createWindParticle(RenderSystem *renderer, const Wind &wind, const Entity &windEntity)
+void createWindParticles(Entity particleBatch, const Wind &wind)
 {
-	auto entity = Entity();
-
-	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
-	Mesh &mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	WindParticle &windParticle = registry.windParticles.emplace(entity, wind, windEntity, glfwGetTime());
-
-	// Initialize the motion
-	auto &motion = registry.motions.emplace(entity);
-	motion.angle = 0.f;
-	motion.velocity = { 0,0 };
-	motion.position = windParticle.GetPos(glfwGetTime());
-	motion.scale = vec2(WALL_SIZE * 0.25f);
-
-	registry.renderRequests.insert(
-		entity,
-		{ TEXTURE_ASSET_ID::WIND_PARTICLE, // TEXTURE_ASSET_ID
-		 EFFECT_ASSET_ID::TEXTURED,
-		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
-
-	return entity;
-}
-
-Entity createBee(RenderSystem *renderer, const Entity &targetEntity, vec2 beeBornPos)
-{
-	auto entity = Entity();
-
-	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
-	Mesh &mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	uniform_real_distribution<float> uni(-GUARD_BB_WIDTH, GUARD_BB_WIDTH);
-	vec2 diffPosWithTarget(uni(eng), uni(eng));
-
-	Bee &bee = registry.bees.emplace(entity, targetEntity, diffPosWithTarget, beeBornPos);
-
-	// Initialize the motion
-	auto &motion = registry.motions.emplace(entity);
-	motion.angle = 0.f;
-	motion.velocity = { 0,0 };
-	motion.position = beeBornPos;
-	motion.scale = vec2(WALL_SIZE * 0.5f);
-
-	registry.renderRequests.insert(
-		entity,
-		{ TEXTURE_ASSET_ID::BEE,
-		 EFFECT_ASSET_ID::TEXTURED,
-		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
-
-	return entity;
+	std::uniform_real_distribution<float> uni(0, 1);
+	std::uniform_real_distribution<float> uniV(wind.length / 5.0f, wind.length);
+	ParticleBatch &batch = registry.particleBatches.get(particleBatch);
+
+	// along the flow, with a sin wave across it
+	vec2 flow = { 1, 0 };
+	vec2 across = { 0, 1 };
+	if (wind.dir == Direction::UP || wind.dir == Direction::DOWN)
+		std::swap(flow, across);
+	if (wind.dir == Direction::LEFT || wind.dir == Direction::UP)
+		flow = -flow;
+
+	const float now = (float)glfwGetTime();
+	for (int i = 0; i < WIND_PARTICLE_LIMIT; ++i)
+	{
+		// every particle loops over the length of the wind, they start at different points of it
+		Particle particle = {};
+		float v = uniV(eng);
+		particle.origin = wind.pos;
+		particle.velocity = flow * v;
+		particle.wave = across * wind.width;
+		particle.frequency = 2.0f * (float)M_PI / wind.length;
+		particle.seed = uni(eng);
+		particle.size = vec2(WALL_SIZE * 0.25f);
+		particle.life = wind.length / v;
+		particle.birth = now - particle.seed * particle.life;
+		particle.loop = 1;
+		batch.particles.push_back(particle);
+	}
+	batch.dirty = true;
 }
 
 Entity createTrapUI(RenderSystem* renderer, vec2 position) {
@@ -374,7 +372,8 @@ Entity createTrapUI(RenderSystem* renderer, vec2 position) {
 		{ TEXTURE_ASSET_ID::TRAP,
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		 false });
+		 false,
+		 RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -400,7 +399,8 @@ Entity createMultiply(RenderSystem* renderer, vec2 position) {
 		{ TEXTURE_ASSET_ID::MULTI,
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		 false });
+		 false,
+		 RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -441,7 +441,8 @@ Entity createDigit(RenderSystem* renderer, vec2 position, int digit) {
 		{ textureAssetId, // TEXTURE_ASSET_ID
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		 false });
+		 false,
+		 RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -467,7 +468,8 @@ Entity createRecord(RenderSystem* renderer, vec2 position) {
 		{ TEXTURE_ASSET_ID::RECORD,
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		 false });
+		 false,
+		 RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -493,7 +495,8 @@ Entity createHighest(RenderSystem* renderer, vec2 position) {
 		{ TEXTURE_ASSET_ID::HIGHEST,
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		 false });
+		 false,
+		 RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -520,7 +523,8 @@ Entity createBackground(RenderSystem *renderer, vec2 position, vec2 size, enum T
 		{ textureAssetId, // TEXTURE_ASSET_ID
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::BACKGROUND });
 
 	return entity;
 }
@@ -550,7 +554,8 @@ Entity createTextBox(RenderSystem *renderer, vec2 position, enum TEXTURE_ASSET_I
 		{ textureAssetId, // TEXTURE_ASSET_ID
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -579,7 +584,8 @@ Entity createTrap(RenderSystem *renderer, vec2 position) {
 		{ TEXTURE_ASSET_ID::TRAP,
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::GROUND });
 
 	return entity;
 }
@@ -594,7 +600,8 @@ Entity createLine(vec2 position, vec2 scale)
 		{ TEXTURE_ASSET_ID::TEXTURE_COUNT,
 		 EFFECT_ASSET_ID::EGG,
 		 GEOMETRY_BUFFER_ID::DEBUG_LINE,
-		false});
+		false,
+		RENDER_LAYER::DEBUG });
 
 	// Create motion
 	Motion &motion = registry.motions.emplace(entity);
@@ -650,6 +657,29 @@ Entity createNPC(RenderSystem *renderer, vec2 position)
 
 }
 
+Entity createSpriteBatch(TEXTURE_ASSET_ID textureAssetId, vec2 scale)
+{
+	// no motion and no render request, the renderer draws the batch on its own
+	Entity entity = Entity();
+
+	SpriteBatch &batch = registry.spriteBatches.emplace(entity);
+	batch.texture = textureAssetId;
+	batch.scale = scale;
+
+	return entity;
+}
+
+Entity createParticleBatch(TEXTURE_ASSET_ID textureAssetId)
+{
+	// no motion and no render request either, the particles are added by the create functions
+	Entity entity = Entity();
+
+	ParticleBatch &batch = registry.particleBatches.emplace(entity);
+	batch.texture = textureAssetId;
+
+	return entity;
+}
+
 Entity createMovie(RenderSystem *renderer, vec2 pos, vec2 size, std::vector<TEXTURE_ASSET_ID> textures, double frameInterval)
 {
 	auto entity = Entity();
@@ -676,7 +706,8 @@ Entity createMovie(RenderSystem *renderer, vec2 pos, vec2 size, std::vector<TEXT
 		{ TEXTURE_ASSET_ID::BUG, // TEXTURE_ASSET_ID
 		 EFFECT_ASSET_ID::UI,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::UI });
 
 	return entity;
 }
@@ -705,43 +736,38 @@ Entity createTool(RenderSystem *renderer, vec2 position, Tool::ToolType type)
 		{ tool.GetTexId(0),
 		 EFFECT_ASSET_ID::TEXTURED,
 		 GEOMETRY_BUFFER_ID::SPRITE,
-		false});
+		false,
+		RENDER_LAYER::GROUND });
 
 	return entity;
 }
 
-void createExplodeds(RenderSystem *renderer, int count, vec2 position, vec2 size, TEXTURE_ASSET_ID textureAssetId, float life)
+void createExplodeds(Entity particleBatch, int count, vec2 position, vec2 size, float life, vec2 flow)
 {
 	std::uniform_real_distribution<double> uni(0, 1);
+	ParticleBatch &batch = registry.particleBatches.get(particleBatch);
+	const float now = (float)glfwGetTime();
+
+	// the explosions that are over go when a new one starts
+	auto over = [now](const Particle &particle) { return particle.loop == 0 && particle.birth + particle.life <= now; };
+	batch.particles.erase(std::remove_if(batch.particles.begin(), batch.particles.end(), over), batch.particles.end());
 
 	for (int i = 0; i < count; ++i)
 	{
-		auto entity = Entity();
-
-		// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
-		Mesh &mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-		registry.meshPtrs.emplace(entity, &mesh);
-
-
-		//Initialize the motion
 		float v0 = 50 + uni(eng) * 350; // initialized abs of velocity
 		float angle = uni(eng) * 360; // emit direction angle
-		vec2 initSize = (float)uni(eng) * size;
-
-		auto &motion = registry.motions.emplace(entity);
-		motion.angle = angle;
-		motion.velocity = { v0 * cos(angle),v0 * sin(angle) };
-		motion.position = position;
-		motion.scale = initSize;
-
-		registry.explodeds.emplace(entity, life, initSize);
-
-		registry.renderRequests.insert(
-			entity,
-			{ textureAssetId,
-			 EFFECT_ASSET_ID::TEXTURED,
-			 GEOMETRY_BUFFER_ID::SPRITE,
-			true});
+
+		// they fly away, spin and shrink to nothing
+		Particle particle = {};
+		particle.origin = position;
+		particle.velocity = vec2(v0 * cos(angle), v0 * sin(angle)) + flow;
+		particle.size = (float)uni(eng) * size;
+		particle.angle = angle;
+		particle.spin = 100.0f;
+		particle.birth = now;
+		particle.life = life / 1000.0f;
+		particle.shrink = 1;
+		batch.particles.push_back(particle);
 	}
-	return;
+	batch.dirty = true;
 }
@@ -14,6 +14,7 @@ const float GUARD_BB_WIDTH = 0.2f * 512.f;
 const float GUARD_BB_HEIGHT = 0.2f * 512.f;
 const float NPC_BB_WIDTH = 0.3f * 165.f;
 const float NPC_BB_HEIGHT = 0.3f * 165.f;
+const float CROWD_BB_SIZE = 0.18f * 165.f; // the wandering students, smaller than the NPCs
 const float WALL_BB_WIDTH = 0.15f * 202.f;
 const float WALL_BB_HEIGHT = 0.15f * 202.f;
 const float EXIT_BB_WIDTH = 0.1f * 474.f;
@@ -33,6 +34,7 @@ const float LIGHT_BB_HEIGHT = 0.4f * 252.f;
 const float TRAP_BB_WIDTH = 0.1f * 504.f;
 const float TRAP_BB_HEIGHT = 0.15f * 444.f;
 const float WALL_SIZE = 20.2f;
+const float BEE_BB_SIZE = WALL_SIZE * 0.5f;
 
 // tool
 const float TOOL_UI_SIZE = 80.0f;
@@ -47,15 +49,11 @@ const char REMOTE_CONTROL_CHAR = '2';
 const char HAMMER_CHAR = '3';
 const char BEE_CHAR = '4';
 
-// bee
-const float BEE_GOING_TIME = 2.0f;
-const float BEE_STAY_TIME = 5.0f;
-const float BEE_LEAVE_TIME = 2.0f;
-
 // wind
 const float WIND_WIDTH_SIZE = WALL_SIZE * 3.0f;
 const float WIND_LENGTH_SIZE = WALL_SIZE * 5.0f;
 const int WIND_PARTICLE_LIMIT = 20;
+const float WIND_SPEED = 100.0f;
 
 // minimap
 const float MINIMAP_WIDTH_COEF = 0.2f;
@@ -119,17 +117,24 @@ Entity createGameState();
 // create NPC
 Entity createNPC(RenderSystem* renderer, vec2 position);
 
+// a batch of sprites drawn together, the positions are filled later
+Entity createSpriteBatch(enum TEXTURE_ASSET_ID textureAssetId, vec2 scale);
+
+// a batch of particles of one texture, moved by the particle shader
+Entity createParticleBatch(enum TEXTURE_ASSET_ID textureAssetId);
+
 // create movie
 Entity createMovie(RenderSystem *renderer, vec2 pos, vec2 size, std::vector<TEXTURE_ASSET_ID> textures, double frameInterval);
 
 Entity createTool(RenderSystem *renderer, vec2 position, Tool::ToolType type);
 
-void createExplodeds(RenderSystem *renderer,int count, vec2 position, vec2 size, enum TEXTURE_ASSET_ID textureAssetId, float life);
+// count pieces flying out of position for life ms, into a particle batch. the pieces are also carried
+// by flow, the wind at position when they are created
+void createExplodeds(Entity particleBatch, int count, vec2 position, vec2 size, float life, vec2 flow);
 
 Entity createWind(RenderSystem *renderer, vec2 position, float width, float length, Direction dir);
-Entity createWindParticle(RenderSystem *renderer, const Wind &wind, const Entity &windEntity);
-
-Entity createBee(RenderSystem *renderer, const Entity &targetEntity, vec2 beeBornPos);
+// the WIND_PARTICLE_LIMIT particles that loop along a wind, into a particle batch
+void createWindParticles(Entity particleBatch, const Wind &wind);
 
 // create background
 Entity createBackground(RenderSystem* renderer, vec2 position, vec2 size, enum TEXTURE_ASSET_ID textureAssetId);
\ No newline at end of file
@@ -107,10 +107,10 @@ GLFWwindow *WorldSystem::create_window() {
 	return window;
 }
 
-void WorldSystem::init(RenderSystem *renderer_arg) {
+void WorldSystem::init(RenderSystem *renderer_arg, ForceField *windField) {
 	this->renderer = renderer_arg;
 	levelManager.reset(new LevelManager());
-	levelManager->init(renderer,window);
+	levelManager->init(renderer,window,windField);
 
 }
 
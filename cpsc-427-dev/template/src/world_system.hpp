@@ -29,8 +29,8 @@ public:
 	// Creates a window
 	GLFWwindow* create_window();
 
-	// starts the game
-	void init(RenderSystem* renderer);
+	// starts the game, the level builds the winds of the physics system in windField
+	void init(RenderSystem* renderer, ForceField *windField);
 
 	// Steps the game ahead by ms milliseconds
 	void step(float elapsed_ms);